@@ -0,0 +1,132 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright © 2018–2024 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Eigen includes
+#include <Eigen/Core>
+
+// autodiff includes
+#include <autodiff/common/eigen.hpp>
+#include <autodiff/reverse/svar/svar.hpp>
+
+//------------------------------------------------------------------------------
+// SUPPORT FOR EIGEN MATRICES AND VECTORS OF SVAR
+//------------------------------------------------------------------------------
+namespace Eigen {
+
+template<typename T>
+struct NumTraits;
+
+template<typename T>
+struct NumTraits<autodiff::StaticVariable<T>> : NumTraits<T> // permits to get the epsilon, dummy_precision, lowest, highest functions
+{
+    typedef autodiff::StaticVariable<T> Real;
+    typedef autodiff::StaticVariable<T> NonInteger;
+    typedef autodiff::StaticVariable<T> Nested;
+    enum
+    {
+        IsComplex = 0,
+        IsInteger = 0,
+        IsSigned = 1,
+        RequireInitialization = 0,
+        ReadCost = 1,
+        AddCost = 3,
+        MulCost = 3
+    };
+};
+
+template<typename T, typename BinOp>
+struct ScalarBinaryOpTraits<autodiff::StaticVariable<T>, T, BinOp>
+{
+    typedef autodiff::StaticVariable<T> ReturnType;
+};
+
+template<typename T, typename BinOp>
+struct ScalarBinaryOpTraits<T, autodiff::StaticVariable<T>, BinOp>
+{
+    typedef autodiff::StaticVariable<T> ReturnType;
+};
+
+} // namespace Eigen
+
+namespace autodiff {
+namespace reverse {
+namespace detail {
+
+/// Return a matrix or vector of new independent static variables recorded in a given tape, with the same size as a given matrix or vector of values.
+template<typename T, typename X>
+auto variables(StaticTapeBase<T>& tape, const Eigen::DenseBase<X>& x)
+{
+    Eigen::Matrix<StaticVariable<T>, X::RowsAtCompileTime, X::ColsAtCompileTime, 0, X::MaxRowsAtCompileTime, X::MaxColsAtCompileTime> res(x.rows(), x.cols());
+    for(auto i = 0; i < x.size(); ++i)
+        res(i) = tape.variable(x(i));
+    return res;
+}
+
+/// Compute the gradient of static variable y with respect to static variables x, in a vector of the same size as x (fixed-size if x is).
+template<typename T, typename X, typename G>
+void gradient(const StaticVariable<T>& y, const Eigen::DenseBase<X>& x, Eigen::PlainObjectBase<G>& g)
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isStaticVariable<ScalarX>, "Argument x is not a vector with StaticVariable<T> (aka svar) objects.");
+    static_assert(X::IsVectorAtCompileTime, "Argument x is not a vector.");
+
+    g.resize(x.size());
+
+    if(!y.tape)
+    {
+        g.setZero();
+        return;
+    }
+
+    y.tape->propagate(y);
+
+    for(auto i = 0; i < x.size(); ++i)
+        g[i] = y.tape->adjoint(x[i]);
+}
+
+/// Return the gradient of static variable y with respect to static variables x.
+template<typename T, typename X>
+auto gradient(const StaticVariable<T>& y, const Eigen::DenseBase<X>& x)
+{
+    Eigen::Matrix<T, X::SizeAtCompileTime, 1, 0, X::MaxSizeAtCompileTime, 1> g;
+    gradient(y, x, g);
+    return g;
+}
+
+} // namespace detail
+} // namespace reverse
+
+AUTODIFF_DEFINE_EIGEN_TYPEDEFS_ALL_SIZES(autodiff::svar, svar)
+
+using reverse::detail::gradient;
+using reverse::detail::variables;
+
+} // namespace autodiff
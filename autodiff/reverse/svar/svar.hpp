@@ -0,0 +1,417 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright © 2018–2024 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// C++ includes
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+// autodiff includes
+#include <autodiff/common/meta.hpp>
+#include <autodiff/common/numbertraits.hpp>
+
+namespace autodiff {
+namespace reverse {
+using autodiff::detail::Requires;
+using autodiff::detail::isArithmetic;
+using autodiff::detail::PlainType;
+namespace detail {
+
+using std::abs;
+using std::acos;
+using std::asin;
+using std::atan;
+using std::atan2;
+using std::cos;
+using std::cosh;
+using std::erf;
+using std::exp;
+using std::hypot;
+using std::log;
+using std::log10;
+using std::pow;
+using std::sin;
+using std::sinh;
+using std::sqrt;
+using std::tan;
+using std::tanh;
+
+template<typename T> struct StaticVariable;
+
+/// An operation recorded in a @ref StaticTape, with the positions of its arguments in the tape and the partial derivatives w.r.t. them.
+/// Operations with one argument have a zero partial derivative w.r.t. the second,
+/// and independent variables have zero partial derivatives w.r.t. both, so that
+/// the reverse sweep has no branches.
+template<typename T>
+struct StaticEntry
+{
+    /// The position of the first argument in the tape.
+    std::size_t a;
+
+    /// The position of the second argument in the tape.
+    std::size_t b;
+
+    /// The partial derivative w.r.t. the first argument.
+    T da;
+
+    /// The partial derivative w.r.t. the second argument.
+    T db;
+};
+
+/// The tape of a @ref StaticTape, independent of its capacity (the tape static variables refer to).
+template<typename T>
+struct StaticTapeBase
+{
+    /// The recorded operations, in the order they were computed.
+    StaticEntry<T>* entries;
+
+    /// The derivatives of the root variable of the last reverse sweep w.r.t. each recorded operation.
+    T* adjoints;
+
+    /// The maximum number of operations that can be recorded.
+    std::size_t capacity;
+
+    /// The number of recorded operations.
+    std::size_t size = 0;
+
+    /// The number of recorded operations whose adjoints were computed in the last reverse sweep (those up to its root variable).
+    std::size_t swept = 0;
+
+    /// Construct a StaticTapeBase object with given storage of recorded operations and their adjoints.
+    StaticTapeBase(StaticEntry<T>* e, T* a, std::size_t n) : entries(e), adjoints(a), capacity(n) {}
+
+    StaticTapeBase(const StaticTapeBase&) = delete;
+
+    StaticTapeBase& operator=(const StaticTapeBase&) = delete;
+
+    /// Record an operation with given arguments and partial derivatives w.r.t. them, and return its position in the tape.
+    /// Throws a std::length_error if the capacity of the tape has been reached.
+    std::size_t push(std::size_t a, const T& da, std::size_t b, const T& db)
+    {
+        if(size == capacity)
+            throw std::length_error("The capacity of the static tape has been exceeded.");
+        entries[size] = { a, b, da, db };
+        return size++;
+    }
+
+    /// Remove all recorded operations, so that the tape can be reused (e.g., for the next evaluation of a kernel).
+    void clear() { size = 0; swept = 0; }
+
+    /// Return a new independent variable recorded in this tape with given value.
+    StaticVariable<T> variable(const T& val)
+    {
+        return { val, this, push(0, T(0.0), 0, T(0.0)) };
+    }
+
+    /// Compute the derivatives of a root variable w.r.t. every operation recorded before it in a single reverse sweep.
+    void propagate(const StaticVariable<T>& y)
+    {
+        assert(y.tape == this);
+        std::fill(adjoints, adjoints + y.index + 1, T(0.0));
+        adjoints[y.index] = 1.0;
+        swept = y.index + 1;
+        for(auto i = y.index + 1; i > 0; --i)
+        {
+            const auto& e = entries[i - 1];
+            const T w = adjoints[i - 1];
+            adjoints[e.a] += w * e.da;
+            adjoints[e.b] += w * e.db;
+        }
+    }
+
+    /// Return the derivative of the root variable of the last reverse sweep w.r.t. a given variable (zero if not in this tape, or recorded after the root variable).
+    T adjoint(const StaticVariable<T>& x) const
+    {
+        return x.tape == this && x.index < swept ? adjoints[x.index] : T(0.0);
+    }
+};
+
+/// The tape of static variables, with storage for N operations in the tape object itself (e.g., on the stack).
+/// Static variables are plain values with the position of their operation in a
+/// tape, so that computing them, and their derivatives in a reverse sweep, never
+/// allocates memory. This suits small kernels with a known bound on the number of
+/// operations (e.g., functions of Vector3svar objects) evaluated many times, each
+/// time after clearing the tape. Only first-order derivatives are supported.
+template<typename T, std::size_t N>
+struct StaticTape : StaticTapeBase<T>
+{
+    /// The storage of the recorded operations.
+    std::array<StaticEntry<T>, N> entrystorage;
+
+    /// The storage of the adjoints of the recorded operations.
+    std::array<T, N> adjointstorage;
+
+    /// Construct a StaticTape object.
+    StaticTape() : StaticTapeBase<T>(nullptr, nullptr, N)
+    {
+        this->entries = entrystorage.data();
+        this->adjoints = adjointstorage.data();
+    }
+};
+
+/// The autodiff variable type used for static reverse mode automatic differentiation (see @ref StaticTape).
+template<typename T>
+struct StaticVariable
+{
+    static_assert(isArithmetic<T>, "Static variables support only first-order derivatives.");
+
+    /// The value of this variable.
+    T val = {};
+
+    /// The tape where the operation of this variable is recorded (nullptr if this variable is a constant).
+    StaticTapeBase<T>* tape = nullptr;
+
+    /// The position of the operation of this variable in its tape.
+    std::size_t index = 0;
+
+    /// Construct a default StaticVariable object (a zero constant).
+    StaticVariable() = default;
+
+    /// Construct a StaticVariable object with given arithmetic value (a constant).
+    template<typename U, Requires<isArithmetic<U>> = true>
+    StaticVariable(const U& v) : val(v) {}
+
+    /// Construct a StaticVariable object with given value and recorded operation.
+    StaticVariable(const T& v, StaticTapeBase<T>* t, std::size_t i) : val(v), tape(t), index(i) {}
+
+    StaticVariable& operator+=(const StaticVariable& x) { return *this = *this + x; }
+    StaticVariable& operator-=(const StaticVariable& x) { return *this = *this - x; }
+    StaticVariable& operator*=(const StaticVariable& x) { return *this = *this * x; }
+    StaticVariable& operator/=(const StaticVariable& x) { return *this = *this / x; }
+
+#if defined(AUTODIFF_ENABLE_IMPLICIT_CONVERSION_VAR) || defined(AUTODIFF_ENABLE_IMPLICIT_CONVERSION)
+    operator T() const { return val; }
+
+    template<typename U>
+    operator U() const { return static_cast<U>(val); }
+#else
+    explicit operator T() const { return val; }
+
+    template<typename U>
+    explicit operator U() const { return static_cast<U>(val); }
+#endif
+};
+
+template<typename T> struct isStaticVariableTrait { constexpr static bool value = false; };
+template<typename T> struct isStaticVariableTrait<StaticVariable<T>> { constexpr static bool value = true; };
+
+/// A compile-time constant that indicates whether a type is a static variable.
+template<typename T>
+constexpr bool isStaticVariable = isStaticVariableTrait<PlainType<T>>::value;
+
+/// A compile-time constant that indicates whether the arguments of a binary operation make a static variable.
+template<typename L, typename R>
+constexpr bool isStaticOperands = (isStaticVariable<L> && (isStaticVariable<R> || isArithmetic<R>)) || (isArithmetic<L> && isStaticVariable<R>);
+
+/// The value type of the static variable among the arguments of a binary operation.
+template<typename L, typename R>
+using StaticValueType = decltype(std::declval<PlainType<std::conditional_t<isStaticVariable<L>, L, R>>>().val);
+
+/// Return the static variable of an operation with one argument, given its value and its derivative w.r.t. the argument.
+template<typename T>
+auto record_unary(const T& val, const StaticVariable<T>& x, const T& dx) -> StaticVariable<T>
+{
+    if(!x.tape)
+        return StaticVariable<T>(val);
+    return { val, x.tape, x.tape->push(x.index, dx, x.index, T(0.0)) };
+}
+
+/// Return the static variable of an operation with two arguments, given its value and its derivatives w.r.t. the arguments.
+template<typename T>
+auto record_binary(const T& val, const StaticVariable<T>& x, const T& dx, const StaticVariable<T>& y, const T& dy) -> StaticVariable<T>
+{
+    if(!x.tape)
+        return record_unary(val, y, dy);
+    if(!y.tape)
+        return record_unary(val, x, dx);
+    assert(x.tape == y.tape && "Static variables in the same operation must be recorded in the same tape.");
+    return { val, x.tape, x.tape->push(x.index, dx, y.index, dy) };
+}
+
+//------------------------------------------------------------------------------
+// ARITHMETIC OPERATORS
+//------------------------------------------------------------------------------
+template<typename T> auto operator+(const StaticVariable<T>& x) { return x; }
+template<typename T> auto operator-(const StaticVariable<T>& x) { return record_unary(-x.val, x, T(-1.0)); }
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto operator+(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    return record_binary(x.val + y.val, x, T(1.0), y, T(1.0));
+}
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto operator-(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    return record_binary(x.val - y.val, x, T(1.0), y, T(-1.0));
+}
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto operator*(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    return record_binary(x.val * y.val, x, y.val, y, x.val);
+}
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto operator/(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    const T aux = 1.0 / y.val;
+    return record_binary(x.val * aux, x, aux, y, -x.val * aux * aux);
+}
+
+//------------------------------------------------------------------------------
+// COMPARISON OPERATORS
+//------------------------------------------------------------------------------
+
+/// Return the value of a static variable or arithmetic argument of an operation with a static variable.
+template<typename T, typename X>
+auto static_value(const X& x) -> T { return StaticVariable<T>(x).val; }
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true> bool operator==(const L& l, const R& r) { using T = StaticValueType<L, R>; return static_value<T>(l) == static_value<T>(r); }
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true> bool operator!=(const L& l, const R& r) { using T = StaticValueType<L, R>; return static_value<T>(l) != static_value<T>(r); }
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true> bool operator<=(const L& l, const R& r) { using T = StaticValueType<L, R>; return static_value<T>(l) <= static_value<T>(r); }
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true> bool operator>=(const L& l, const R& r) { using T = StaticValueType<L, R>; return static_value<T>(l) >= static_value<T>(r); }
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true> bool operator<(const L& l, const R& r) { using T = StaticValueType<L, R>; return static_value<T>(l) < static_value<T>(r); }
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true> bool operator>(const L& l, const R& r) { using T = StaticValueType<L, R>; return static_value<T>(l) > static_value<T>(r); }
+
+//------------------------------------------------------------------------------
+// TRIGONOMETRIC FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> auto sin(const StaticVariable<T>& x) { return record_unary(sin(x.val), x, cos(x.val)); }
+template<typename T> auto cos(const StaticVariable<T>& x) { return record_unary(cos(x.val), x, -sin(x.val)); }
+template<typename T> auto tan(const StaticVariable<T>& x) { const T aux = 1.0 / cos(x.val); return record_unary(tan(x.val), x, aux * aux); }
+template<typename T> auto asin(const StaticVariable<T>& x) { return record_unary(asin(x.val), x, T(1.0 / sqrt(1.0 - x.val * x.val))); }
+template<typename T> auto acos(const StaticVariable<T>& x) { return record_unary(acos(x.val), x, T(-1.0 / sqrt(1.0 - x.val * x.val))); }
+template<typename T> auto atan(const StaticVariable<T>& x) { return record_unary(atan(x.val), x, T(1.0 / (1.0 + x.val * x.val))); }
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto atan2(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> y(l), x(r);
+    const T aux = 1.0 / (x.val * x.val + y.val * y.val);
+    return record_binary(atan2(y.val, x.val), y, x.val * aux, x, -y.val * aux);
+}
+
+//------------------------------------------------------------------------------
+// HYPOT2 FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto hypot(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    const T h = hypot(x.val, y.val);
+    return record_binary(h, x, x.val / h, y, y.val / h);
+}
+
+//------------------------------------------------------------------------------
+// HYPERBOLIC FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> auto sinh(const StaticVariable<T>& x) { return record_unary(sinh(x.val), x, cosh(x.val)); }
+template<typename T> auto cosh(const StaticVariable<T>& x) { return record_unary(cosh(x.val), x, sinh(x.val)); }
+template<typename T> auto tanh(const StaticVariable<T>& x) { const T aux = 1.0 / cosh(x.val); return record_unary(tanh(x.val), x, aux * aux); }
+
+//------------------------------------------------------------------------------
+// EXPONENTIAL AND LOGARITHMIC FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> auto exp(const StaticVariable<T>& x) { const T e = exp(x.val); return record_unary(e, x, e); }
+template<typename T> auto log(const StaticVariable<T>& x) { return record_unary(log(x.val), x, T(1.0 / x.val)); }
+template<typename T> auto log10(const StaticVariable<T>& x) { return record_unary(log10(x.val), x, T(1.0 / (log(10.0) * x.val))); }
+
+//------------------------------------------------------------------------------
+// POWER FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> auto sqrt(const StaticVariable<T>& x) { const T s = sqrt(x.val); return record_unary(s, x, T(0.5 / s)); }
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto pow(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    const T p = pow(x.val, y.val);
+    const T dx = y.tape ? p * y.val / x.val : y.val * pow(x.val, y.val - 1.0); // the second form is also defined at x = 0
+    const T dy = y.tape ? p * log(x.val) : T(0.0);
+    return record_binary(p, x, dx, y, dy);
+}
+
+//------------------------------------------------------------------------------
+// OTHER FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> auto abs(const StaticVariable<T>& x) { return record_unary(abs(x.val), x, T(x.val < 0.0 ? -1.0 : x.val > 0.0 ? 1.0 : 0.0)); }
+template<typename T> auto abs2(const StaticVariable<T>& x) { return x * x; }
+template<typename T> auto conj(const StaticVariable<T>& x) { return x; }
+template<typename T> auto real(const StaticVariable<T>& x) { return x; }
+template<typename T> auto imag(const StaticVariable<T>&) { return StaticVariable<T>(0.0); }
+template<typename T> auto erf(const StaticVariable<T>& x) { constexpr auto sqrt_pi = static_cast<T>(1.7724538509055160272981674833411451872554456638435); return record_unary(erf(x.val), x, T(2.0 / sqrt_pi * exp(-x.val * x.val))); }
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto min(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    return x.val < y.val ? x : y;
+}
+
+template<typename L, typename R, Requires<isStaticOperands<L, R>> = true>
+auto max(const L& l, const R& r)
+{
+    using T = StaticValueType<L, R>;
+    const StaticVariable<T> x(l), y(r);
+    return x.val > y.val ? x : y;
+}
+
+/// Return the value of a static variable.
+template<typename T>
+auto val(const StaticVariable<T>& x) { return x.val; }
+
+} // namespace detail
+} // namespace reverse
+
+using reverse::detail::StaticTape;
+using reverse::detail::StaticVariable;
+using reverse::detail::val;
+
+using svar = StaticVariable<double>;
+
+} // namespace autodiff
@@ -30,7 +30,10 @@
 #pragma once
 
 // Eigen includes
+#include <Eigen/Cholesky>
 #include <Eigen/Core>
+#include <Eigen/LU>
+#include <Eigen/SparseCore>
 
 // autodiff includes
 #include <autodiff/common/eigen.hpp>
@@ -105,18 +108,102 @@ struct ScalarBinaryOpTraits<T, autodiff::reverse::detail::ExprPtr<T>, BinOp>
     typedef autodiff::Variable<T> ReturnType;
 };
 
+#if EIGEN_VERSION_AT_LEAST(3, 3, 90)
+
+namespace internal {
+
+/// The reduction of a matrix or vector of var objects with sums (e.g., `x.sum()`, `x.dot(y)`, `x.squaredNorm()`).
+/// The result is a single SumExpr (or DotExpr) node with all entries as child expression
+/// nodes, instead of a chain of AddExpr (and MulExpr) nodes with one entry added at a time.
+template<typename T>
+struct VariableSumRedux
+{
+    using Scalar = autodiff::Variable<T>;
+
+    using ExprPtr = autodiff::reverse::detail::ExprPtr<T>;
+
+    template<typename Evaluator, typename Func, typename XprType>
+    static Scalar run(const Evaluator& eval, const Func&, const XprType& xpr)
+    {
+        std::vector<ExprPtr> terms;
+        terms.reserve(xpr.size());
+        for(Index i = 0; i < xpr.outerSize(); ++i)
+            for(Index j = 0; j < xpr.innerSize(); ++j)
+                terms.push_back(eval.coeffByOuterInner(i, j).expr);
+        return Scalar(ExprPtr(autodiff::reverse::detail::make_expr<autodiff::reverse::detail::SumExpr<T>>(std::move(terms))));
+    }
+
+    template<typename Evaluator, typename Func, typename Lhs, typename Rhs>
+    static Scalar run(const Evaluator&, const Func&, const CwiseBinaryOp<scalar_conj_product_op<Scalar, Scalar>, Lhs, Rhs>& xpr)
+    {
+        return dot(xpr.lhs(), xpr.rhs());
+    }
+
+    template<typename Evaluator, typename Func, typename Lhs, typename Rhs>
+    static Scalar run(const Evaluator&, const Func&, const CwiseBinaryOp<scalar_product_op<Scalar, Scalar>, Lhs, Rhs>& xpr)
+    {
+        return dot(xpr.lhs(), xpr.rhs());
+    }
+
+    template<typename Evaluator, typename Func, typename Arg>
+    static Scalar run(const Evaluator&, const Func&, const CwiseUnaryOp<scalar_abs2_op<Scalar>, Arg>& xpr)
+    {
+        return dot(xpr.nestedExpression(), xpr.nestedExpression());
+    }
+
+    template<typename Lhs, typename Rhs>
+    static Scalar dot(const Lhs& l, const Rhs& r)
+    {
+        const evaluator<Lhs> evall(l);
+        const evaluator<Rhs> evalr(r);
+        const Index n = l.size();
+        std::vector<ExprPtr> factors(2 * n);
+        Index k = 0;
+        for(Index j = 0; j < l.cols(); ++j)
+            for(Index i = 0; i < l.rows(); ++i, ++k)
+            {
+                factors[k] = evall.coeff(i, j).expr;
+                factors[n + k] = evalr.coeff(i, j).expr;
+            }
+        return Scalar(ExprPtr(autodiff::reverse::detail::make_expr<autodiff::reverse::detail::DotExpr<T>>(std::move(factors))));
+    }
+};
+
+template<typename T, typename Evaluator>
+struct redux_impl<scalar_sum_op<autodiff::Variable<T>, autodiff::Variable<T>>, Evaluator, DefaultTraversal, NoUnrolling> : VariableSumRedux<T> {};
+
+template<typename T, typename Evaluator>
+struct redux_impl<scalar_sum_op<autodiff::Variable<T>, autodiff::Variable<T>>, Evaluator, DefaultTraversal, CompleteUnrolling> : VariableSumRedux<T> {};
+
+} // namespace internal
+
+#endif
+
 } // namespace Eigen
 
 namespace autodiff {
 namespace reverse {
 namespace detail {
 
+/// The number of root expression nodes whose derivatives are computed together in vector-mode reverse sweeps (see Tape::propagate).
+constexpr auto adjoint_lanes = 16;
+
 template<typename T, int Rows, int MaxRows>
 using Vec = Eigen::Matrix<T, Rows, 1, 0, MaxRows, 1>;
 
 template<typename T, int Rows, int Cols, int MaxRows, int MaxCols>
 using Mat = Eigen::Matrix<T, Rows, Cols, 0, MaxRows, MaxCols>;
 
+/// Return the expression nodes of a vector of variables, those the derivatives are computed for (see Tape::activate).
+template<typename T, typename X>
+auto wrtnodes(const Eigen::DenseBase<X>& x)
+{
+    std::vector<const Expr<T>*> nodes(x.size());
+    for(auto i = 0; i < x.size(); ++i)
+        nodes[i] = x[i].expr.get();
+    return nodes;
+}
+
 /// Return the gradient vector of variable y with respect to variables x.
 template<typename T, typename X>
 auto gradient(const Variable<T>& y, Eigen::DenseBase<X>& x)
@@ -134,17 +221,203 @@ auto gradient(const Variable<T>& y, Eigen::DenseBase<X>& x)
 
     const auto n = x.size();
     using Gradient = Vec<U, Rows, MaxRows>;
-    Gradient g = Gradient::Zero(n);
+    Gradient g(n);
+
+    Tape<U> tape(y.expr.get());
+    tape.activate(wrtnodes<U>(x).data(), n);
+    tape.propagate(1.0);
 
     for(auto i = 0; i < n; ++i)
-        x[i].expr->bind_value(&g[i]);
+        g[i] = tape.adjoint(x[i].expr.get());
 
-    y.expr->propagate(1.0);
+    return g;
+}
+
+/// The caller-provided vector where gradients are accumulated (e.g., a `VectorXd` or a segment of it).
+template<typename T>
+using GradientRef = Eigen::Ref<Vec<VariableValueType<T>, Eigen::Dynamic, Eigen::Dynamic>>;
 
+/// Add the gradient vector of variable y with respect to variables x to a caller-provided vector, without allocating memory.
+/// The reverse sweep reuses the tape of the current thread (see @ref scratch_tape).
+/// @param y The dependent variable.
+/// @param x The independent variables.
+/// @param g The vector of size `x.size()` where the gradient is accumulated.
+template<typename T, typename X>
+void gradient(const Variable<T>& y, Eigen::DenseBase<X>& x, GradientRef<T> g)
+{
+    using U = VariableValueType<T>;
+
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects..");
+    static_assert(X::IsVectorAtCompileTime, "Argument x is not a vector.");
+
+    const auto n = x.size();
+    assert(g.size() == n);
+
+    static thread_local std::vector<const Expr<U>*> nodes;
+    nodes.resize(n);
     for(auto i = 0; i < n; ++i)
-        x[i].expr->bind_value(nullptr);
+        nodes[i] = x[i].expr.get();
 
-    return g;
+    auto& tape = scratch_tape<U>();
+    tape.record(y.expr.get());
+    tape.activate(nodes.data(), n);
+    tape.propagate(1.0);
+
+    for(auto i = 0; i < n; ++i)
+        g[i] += tape.adjoint(nodes[i]);
+}
+
+/// Add the gradient vector of variable y with respect to the variables bound to a @ref GradientContext to a caller-provided vector, without allocating memory.
+/// @param y The dependent variable.
+/// @param context The independent variables and the tape reused in every reverse sweep.
+/// @param g The vector of size `context.size()` where the gradient is accumulated.
+template<typename T>
+void gradient(const Variable<T>& y, GradientContext<T>& context, GradientRef<T> g)
+{
+    assert(static_cast<std::size_t>(g.size()) == context.size());
+    context.accumulate(y, g.data());
+}
+
+/// Compute the Jacobian matrix of variables Y with respect to variables x.
+/// The expression trees of all variables in Y are recorded once in a single tape,
+/// which is then swept in reverse for a chunk of rows of the Jacobian at a time
+/// (see @ref adjoint_lanes), reusing its adjoint buffers for every chunk.
+template<typename Y, typename X, typename Jac>
+void jacobian(const Eigen::DenseBase<Y>& Yvec, Eigen::DenseBase<X>& x, Eigen::PlainObjectBase<Jac>& J)
+{
+    using ScalarY = typename Y::Scalar;
+    static_assert(isVariable<ScalarY>, "Argument Y is not a vector with Variable<T> (aka var) objects.");
+
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+
+    static_assert(Y::IsVectorAtCompileTime, "Argument Y is not a vector.");
+    static_assert(X::IsVectorAtCompileTime, "Argument x is not a vector.");
+
+    using U = VariableValueType<ScalarY>;
+
+    const auto m = Yvec.size();
+    const auto n = x.size();
+
+    J.resize(m, n);
+
+    std::vector<Expr<U>*> roots(m);
+    for(auto i = 0; i < m; ++i)
+        roots[i] = Yvec[i].expr.get();
+
+    Tape<U> tape;
+    tape.record(roots.data(), roots.size());
+    tape.activate(wrtnodes<U>(x).data(), n);
+    tape.store(); // the tape is swept once per chunk of rows, so the partial derivatives are computed only once
+
+    for(auto i = 0; i < m; i += adjoint_lanes)
+    {
+        const auto count = std::min<Eigen::Index>(adjoint_lanes, m - i);
+        tape.propagate(roots.data() + i, count);
+
+        for(auto l = 0; l < count; ++l)
+            for(auto k = 0; k < n; ++k)
+                J(i + l, k) = tape.adjoint(x[k].expr.get(), l);
+    }
+}
+
+/// Return the Jacobian matrix of variables Y with respect to variables x.
+template<typename Y, typename X>
+auto jacobian(const Eigen::DenseBase<Y>& Yvec, Eigen::DenseBase<X>& x)
+{
+    using U = VariableValueType<typename Y::Scalar>;
+    Mat<U, Y::RowsAtCompileTime, X::RowsAtCompileTime, Y::MaxRowsAtCompileTime, X::MaxRowsAtCompileTime> J;
+    jacobian(Yvec, x, J);
+    return J;
+}
+
+/// Compute the product of the Hessian matrix of variable y with respect to variables x and a vector v.
+/// The product is computed in a forward and a reverse sweep over the expression
+/// tree of y, which carry directional derivatives along v (forward-over-reverse),
+/// without building the expression trees of the gradient (as @ref hessian does).
+/// The sweeps reuse the tape of the current thread (see @ref scratch_tape).
+template<typename T, typename X, typename V, typename HV>
+void hessian_vector_product(const Variable<T>& y, Eigen::DenseBase<X>& x, const Eigen::DenseBase<V>& v, Eigen::PlainObjectBase<HV>& Hv)
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+    static_assert(isArithmetic<T>, "Hessian-vector products are supported only for first-order variables (e.g., var).");
+
+    const auto n = x.size();
+    assert(v.size() == n);
+
+    auto& tape = scratch_tape<T>();
+    tape.record(y.expr.get());
+
+    tape.tangents.assign(tape.nodes.size(), T(0.0));
+    for(auto k = 0; k < n; ++k)
+        if(tape.contains(x[k].expr.get()))
+            tape.tangents[x[k].expr->index] += v[k];
+
+    tape.propagatetangents(1.0);
+
+    Hv.resize(n);
+    for(auto k = 0; k < n; ++k)
+        Hv[k] = tape.contains(x[k].expr.get()) ? tape.adjointtangents[x[k].expr->index] : T(0.0);
+}
+
+/// Return the product of the Hessian matrix of variable y with respect to variables x and a vector v.
+template<typename T, typename X, typename V>
+auto hessian_vector_product(const Variable<T>& y, Eigen::DenseBase<X>& x, const Eigen::DenseBase<V>& v)
+{
+    Vec<T, X::RowsAtCompileTime, X::MaxRowsAtCompileTime> Hv;
+    hessian_vector_product(y, x, v, Hv);
+    return Hv;
+}
+
+/// Return the Hessian matrix of variable y with respect to variables x as a sparse matrix.
+/// The Hessian is computed in a single second-order reverse sweep over the
+/// expression tree of y (edge pushing, see Tape::propagateedges), which only
+/// stores the second-order derivatives of pairs of expression nodes that
+/// interact nonlinearly, instead of forming a dense matrix in n reverse sweeps.
+/// The variables x must be independent, as the second-order derivatives w.r.t.
+/// dependent variables are pushed down to the variables they depend on.
+template<typename T, typename X>
+auto sparse_hessian(const Variable<T>& y, Eigen::DenseBase<X>& x) -> Eigen::SparseMatrix<T>
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+    static_assert(isArithmetic<T>, "Sparse Hessian matrices are supported only for first-order variables (e.g., var).");
+
+    const auto n = x.size();
+
+    for(auto k = 0; k < n; ++k)
+        if(!dynamic_cast<IndependentVariableExpr<T>*>(x[k].expr.get()))
+            throw std::logic_error("Cannot compute a sparse Hessian matrix w.r.t. a variable that is not independent");
+
+    Tape<T> tape(y.expr.get());
+    tape.propagateedges(1.0);
+
+    // The positions in x of the expression nodes in the tape (-1 if not in x)
+    std::vector<Eigen::Index> positions(tape.nodes.size(), -1);
+    for(auto k = 0; k < n; ++k)
+        if(tape.contains(x[k].expr.get()))
+            positions[x[k].expr->index] = k;
+
+    std::vector<Eigen::Triplet<T>> triplets;
+    for(auto i = 0U; i < tape.nodes.size(); ++i)
+    {
+        if(positions[i] < 0)
+            continue;
+        for(const auto& [j, value] : tape.edges[i])
+        {
+            if(positions[j] < 0)
+                continue;
+            triplets.emplace_back(positions[i], positions[j], value);
+            if(i != j)
+                triplets.emplace_back(positions[j], positions[i], value);
+        }
+    }
+
+    Eigen::SparseMatrix<T> H(n, n);
+    H.setFromTriplets(triplets.begin(), triplets.end()); // duplicate entries are summed
+    return H;
 }
 
 /// Return the Hessian matrix of variable y with respect to variables x.
@@ -168,17 +441,13 @@ auto hessian(const Variable<T>& y, Eigen::DenseBase<X>& x, GradientVec& g)
     using ExpressionGradient = Vec<ScalarX, Rows, MaxRows>;
     ExpressionGradient G(n);
 
-    for(auto k = 0; k < n; ++k)
-        x[k].expr->bind_expr(&G(k).expr);
-
-    /* Build a full gradient expression in DFS tree traversal, updating
-     * gradient expressions when encountering variables
-     */
-    y.expr->propagatex(constant<T>(1.0));
+    // Build the full gradient expression in a single reverse sweep over the expression tree of y
+    Tape<T> tapex(y.expr.get());
+    tapex.activate(wrtnodes<T>(x).data(), n);
+    tapex.propagatex(constant<T>(1.0));
 
-    for(auto k = 0; k < n; ++k) {
-      x[k].expr->bind_expr(nullptr);
-    }
+    for(auto k = 0; k < n; ++k)
+        G(k).expr = tapex.adjointx(x[k].expr.get());
 
     // Read the gradient value from gradient expressions' cached values
     g.resize(n);
@@ -187,17 +456,27 @@ auto hessian(const Variable<T>& y, Eigen::DenseBase<X>& x, GradientVec& g)
 
     // Form a numeric hessian using the gradient expressions
     using Hessian = Mat<U, Rows, Rows, MaxRows, MaxRows>;
-    Hessian H = Hessian::Zero(n, n);
+    Hessian H(n, n);
+
+    // Record the gradient expression trees of all variables in a single tape
+    std::vector<Expr<U>*> roots(n);
     for(auto i = 0; i < n; ++i)
-    {
-        for(auto k = 0; k < n; ++k)
-            x[k].expr->bind_value(&H(i, k));
+        roots[i] = G[i].expr.get();
 
-        // Propagate a second derivative value calculation down the gradient expression tree for variable i
-        G[i].expr->propagate(1.0);
+    Tape<U> tape;
+    tape.record(roots.data(), roots.size());
+    tape.activate(wrtnodes<U>(x).data(), n);
+    tape.store(); // the tape is swept once per chunk of rows, so the partial derivatives are computed only once
 
-        for(auto k = 0; k < n; ++k)
-            x[k].expr->bind_value(nullptr);
+    // Propagate second derivative value calculations down the gradient expression trees, for a chunk of variables in each sweep
+    for(auto i = 0; i < n; i += adjoint_lanes)
+    {
+        const auto count = std::min<Eigen::Index>(adjoint_lanes, n - i);
+        tape.propagate(roots.data() + i, count);
+
+        for(auto l = 0; l < count; ++l)
+            for(auto k = 0; k < n; ++k)
+                H(i + l, k) = tape.adjoint(x[k].expr.get(), l);
     }
 
     return H;
@@ -214,13 +493,1115 @@ auto hessian(const Variable<T>& y, Eigen::DenseBase<X>& x)
     return hessian(y, x, g);
 }
 
+/// A function of many variables recorded once in a tape that can be replayed for new values of these variables.
+/// Replaying the tape evaluates the recorded expression nodes in topological
+/// order, without creating any new expression node. The control flow of the
+/// function is fixed at recording: conditional expressions (see @ref condition)
+/// select their branch again for the new values, but the branches taken in
+/// the function code (e.g., `if(x[0] > 1.0)`) are only checked, and @ref valid
+/// returns false whenever one of them would be taken differently. The compared
+/// expression trees of these branches are evaluated in the same replay as the
+/// function itself, so that checking them costs one comparison each.
+template<typename T>
+struct ReplayTape
+{
+    using Vector = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+
+    /// The topologically ordered expression nodes of the recorded function.
+    Tape<T> tape;
+
+    /// The root expression node of the recorded function (which keeps its expression tree alive).
+    ExprPtr<T> root;
+
+    /// The expression nodes of the independent variables of the recorded function.
+    std::vector<ExprPtr<T>> inputs;
+
+    /// The comparisons that decided the branches taken in the function code when it was recorded (with their results then).
+    std::vector<ComparisonExpr<T>> comparisons;
+
+    /// The expression nodes of the compared expression trees in @ref comparisons that are not in @ref tape, in topological order.
+    std::vector<Expr<T>*> extras;
+
+    /// The other boolean expressions that decided the branches taken in the function code when it was recorded (e.g., `x[0] > 0 && x[1] > 0`).
+    std::vector<BooleanExpr> branches;
+
+    /// The values of the boolean expressions in @ref branches when the function was recorded.
+    std::vector<bool> taken;
+
+    /// The flag indicating whether the last replay took the same branches as the recording.
+    bool consistent = true;
+
+    /// Construct a ReplayTape object for a given function, recording it for the given values of its variables.
+    template<typename Fun, typename X>
+    ReplayTape(Fun&& f, const Eigen::DenseBase<X>& x)
+    {
+        inputs.resize(x.size());
+        for(auto i = 0; i < x.size(); ++i)
+        {
+            if(!dynamic_cast<IndependentVariableExpr<T>*>(x[i].expr.get()))
+                throw std::logic_error("Cannot record a tape for a variable that is not independent");
+            inputs[i] = x[i].expr;
+        }
+
+        auto* outer = std::exchange(BooleanExpr::recorded(), &branches);
+        auto* outercomparisons = std::exchange(ComparisonExpr<T>::recorded(), &comparisons);
+        {
+            ExprArena arena; // the recorded expression nodes are allocated contiguously
+            const Variable<T> y = f(x.derived());
+            root = y.expr;
+        }
+        BooleanExpr::recorded() = outer;
+        ComparisonExpr<T>::recorded() = outercomparisons;
+
+        for(const auto& branch : branches)
+            taken.push_back(branch.val);
+
+        tape.record(root.get());
+
+        if(!comparisons.empty())
+        {
+            std::vector<Expr<T>*> compared;
+            for(const auto& comparison : comparisons)
+            {
+                compared.push_back(comparison.l.get());
+                compared.push_back(comparison.r.get());
+            }
+            Tape<T> others;
+            others.record(compared.data(), compared.size());
+            others.restore(); // the indices of the expression nodes in tape
+            for(auto* e : others.nodes)
+                if(!tape.contains(e))
+                    extras.push_back(e);
+        }
+
+        for(auto* e : tape.nodes)
+            if(dynamic_cast<PreaccumulatedExpr<T>*>(e))
+                throw std::logic_error("Cannot record a tape with preaccumulated statements, which cannot be replayed");
+    }
+
+    /// Return true if the last replay took the same branches in the function code as the recording (i.e., if its results are valid).
+    bool valid() const { return consistent; }
+
+    /// Return the value of the recorded function for new values of its variables.
+    template<typename X>
+    auto forward(const Eigen::DenseBase<X>& x) -> T
+    {
+        assert(x.size() == static_cast<Eigen::Index>(inputs.size()));
+
+        for(auto i = 0U; i < inputs.size(); ++i)
+            inputs[i]->val = x[i];
+
+        tape.update();
+
+        for(auto* e : extras)
+            e->evaluate();
+
+        consistent = true;
+        for(const auto& comparison : comparisons)
+            consistent = consistent && compare(comparison.op, comparison.l->val, comparison.r->val) == comparison.val;
+        for(auto k = 0U; k < branches.size(); ++k)
+        {
+            branches[k].update();
+            consistent = consistent && branches[k].val == taken[k];
+        }
+
+        return root->val;
+    }
+
+    /// Return the gradient of the recorded function for new values of its variables.
+    template<typename X>
+    auto gradient(const Eigen::DenseBase<X>& x) -> Vector
+    {
+        Vector g;
+        gradient(x, g);
+        return g;
+    }
+
+    /// Compute the gradient of the recorded function for new values of its variables.
+    template<typename X, typename G>
+    void gradient(const Eigen::DenseBase<X>& x, Eigen::PlainObjectBase<G>& g)
+    {
+        forward(x);
+
+        for(auto i = 0U; i < tape.nodes.size(); ++i)
+            tape.nodes[i]->index = i; // in case other tapes have recorded the same expression nodes since
+
+        tape.propagate(1.0);
+
+        g.resize(inputs.size());
+        for(auto i = 0U; i < inputs.size(); ++i)
+            g[i] = tape.adjoint(inputs[i].get());
+    }
+};
+
+/// Return a tape with a function of many variables recorded for the given values of these variables (see @ref ReplayTape).
+/// @param f The function with signature `var(const VectorXvar& x)` to be recorded.
+/// @param x The independent variables of the function.
+template<typename Fun, typename X>
+auto record(Fun&& f, const Eigen::DenseBase<X>& x)
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+    using T = std::decay_t<decltype(std::declval<ScalarX>().expr->val)>;
+    return ReplayTape<T>(std::forward<Fun>(f), x);
+}
+
+/// A function of many variables recorded once in a tape that is replayed for N points at a time (e.g., the samples of a Monte Carlo run).
+/// The values and adjoints of the recorded expression nodes are fixed-size packs
+/// (Eigen arrays of size N), with one lane per point, so that a single forward and
+/// reverse sweep over the tape gives the values and gradients of the function at
+/// all N points. The most common expression node types are evaluated and
+/// differentiated with pack operations (see @ref Opcode), and the others one lane
+/// at a time. Conditional expressions (see @ref condition) select their branch in
+/// each lane with a mask, computed with pack comparisons for @ref SelectExpr nodes,
+/// and the branches taken in the function code are checked in each lane, as in
+/// @ref ReplayTape. Expression nodes with several outputs
+/// (e.g., checkpointed regions) are not supported.
+template<typename T, int N>
+struct BatchTape
+{
+    static_assert(isArithmetic<T>, "Batch tapes are supported only for first-order variables (e.g., var).");
+
+    /// The values of an expression node (or any other quantity) at the N points.
+    using Pack = Eigen::Array<T, N, 1>;
+
+    /// The lane flags of a pack (e.g., whether each point took the recorded branches).
+    using Mask = Eigen::Array<bool, N, 1>;
+
+    using Packs = std::vector<Pack, Eigen::aligned_allocator<Pack>>;
+
+    /// The recorded function, with its topologically ordered expression nodes.
+    ReplayTape<T> recording;
+
+    /// The positions in the inputs of the recorded function of the expression nodes in the tape (-1 if not an input).
+    std::vector<Eigen::Index> positions;
+
+    /// The constants of the @ref ShiftExpr nodes in the tape (zero for the other expression nodes).
+    std::vector<T> shifts;
+
+    /// The positions in the tape of the @ref ConditionalExpr nodes.
+    std::vector<std::size_t> conditionals;
+
+    /// The lanes in which the predicates of the @ref ConditionalExpr nodes hold at the last points (one mask per conditional expression node).
+    std::vector<Mask> masks;
+
+    /// The positions in the tape of the @ref SelectExpr nodes.
+    std::vector<std::size_t> selects;
+
+    /// The lanes in which the comparisons of the @ref SelectExpr nodes hold at the last points (one mask per select expression node).
+    std::vector<Mask> selectmasks;
+
+    /// The positions in the tape of the compared expression nodes of the branches taken in the function code (-1 if not in the tape, see @ref ReplayTape::extras).
+    std::vector<std::pair<Eigen::Index, Eigen::Index>> compared;
+
+    /// The expression nodes in the tape that are child expression nodes of the compared expression nodes not in the tape, with their positions in the tape.
+    std::vector<std::pair<Expr<T>*, std::size_t>> feeds;
+
+    /// The values of the expression nodes in the tape at the last points.
+    Packs values;
+
+    /// The derivatives of the root expression node w.r.t. each expression node in the tape at the last points.
+    Packs adjoints;
+
+    /// The auxiliary array of partial derivatives of an expression node w.r.t. its child expression nodes.
+    Packs buffer;
+
+    /// The auxiliary array of scalar partial derivatives of an expression node evaluated one lane at a time.
+    std::vector<T> scalars;
+
+    /// The lanes in which the last points took the same branches in the function code as the recording.
+    Mask consistent = Mask::Constant(true);
+
+    /// Construct a BatchTape object for a given function, recording it for the given values of its variables.
+    template<typename Fun, typename X>
+    BatchTape(Fun&& f, const Eigen::DenseBase<X>& x) : recording(std::forward<Fun>(f), x)
+    {
+        const auto& tape = recording.tape;
+        const auto n = tape.nodes.size();
+
+        positions.assign(n, -1);
+        for(auto k = 0U; k < recording.inputs.size(); ++k)
+            if(tape.contains(recording.inputs[k].get()))
+                positions[recording.inputs[k]->index] = k;
+
+        shifts.assign(n, T(0.0));
+        std::size_t maxarity = 0;
+        for(auto i = 0U; i < n; ++i)
+        {
+            if(tape.multioutputs[i])
+                throw std::logic_error("Batch tapes of expression nodes with several outputs are not supported.");
+            if(tape.opcodes[i] == Opcode::Shift)
+                shifts[i] = static_cast<ShiftExpr<T>*>(tape.nodes[i])->c;
+            if(dynamic_cast<ConditionalExpr<T>*>(tape.nodes[i]))
+                conditionals.push_back(i);
+            if(dynamic_cast<SelectExpr<T>*>(tape.nodes[i]))
+                selects.push_back(i);
+            maxarity = std::max<std::size_t>(maxarity, tape.offsets[i + 1] - tape.offsets[i]);
+        }
+
+        auto position = [&](const Expr<T>* e) { return tape.contains(e) ? Eigen::Index(e->index) : Eigen::Index(-1); };
+        for(const auto& comparison : recording.comparisons)
+            compared.emplace_back(position(comparison.l.get()), position(comparison.r.get()));
+        for(auto* e : recording.extras)
+            for(auto k = 0U; k < e->arity(); ++k)
+                if(tape.contains(e->operand(k)))
+                    feeds.emplace_back(e->operand(k), e->operand(k)->index);
+
+        masks.resize(conditionals.size());
+        selectmasks.resize(selects.size());
+        buffer.resize(maxarity);
+        scalars.resize(maxarity);
+    }
+
+    /// Return true if the last points all took the same branches in the function code as the recording (i.e., if all lanes of the results are valid).
+    bool valid() const { return consistent.all(); }
+
+    /// Return the lanes in which a comparison between the values of two expression nodes at the last points holds.
+    static auto comparison(Comparison op, const Pack& a, const Pack& b) -> Mask
+    {
+        switch(op)
+        {
+            case Comparison::Less: return a < b;
+            case Comparison::Greater: return a > b;
+            case Comparison::LessEqual: return a <= b;
+            case Comparison::GreaterEqual: return a >= b;
+            case Comparison::Equal: return a == b;
+            default: return a != b;
+        }
+    }
+
+    /// Return the values of the recorded function at N points.
+    /// @param X The matrix whose N columns are the values of the variables at each point.
+    template<typename P>
+    auto forward(const Eigen::MatrixBase<P>& X) -> Pack
+    {
+        auto& tape = recording.tape;
+        const auto n = tape.nodes.size();
+
+        assert(X.rows() == static_cast<Eigen::Index>(recording.inputs.size()));
+        assert(X.cols() == N);
+
+        // The branches of conditional expressions and of the function code, decided by predicates on the scalar values of the expression nodes, one lane at a time
+        consistent.setConstant(true);
+        if(!conditionals.empty() || !recording.branches.empty())
+        {
+            for(auto l = 0; l < N; ++l)
+            {
+                for(auto k = 0U; k < recording.inputs.size(); ++k)
+                    recording.inputs[k]->val = X(k, l);
+                for(auto c = 0U; c < conditionals.size(); ++c)
+                {
+                    auto& predicate = static_cast<ConditionalExpr<T>*>(tape.nodes[conditionals[c]])->predicate;
+                    predicate.update();
+                    masks[c][l] = predicate.val;
+                }
+                for(auto k = 0U; k < recording.branches.size(); ++k)
+                {
+                    recording.branches[k].update();
+                    consistent[l] = consistent[l] && recording.branches[k].val == recording.taken[k];
+                }
+            }
+        }
+
+        for(auto i = 0U; i < n; ++i)
+            tape.nodes[i]->index = i; // in case other tapes have recorded the same expression nodes since
+
+        values.resize(n);
+
+        std::size_t c = 0; // the next conditional expression node
+        std::size_t s = 0; // the next select expression node
+
+        for(auto i = 0U; i < n; ++i)
+        {
+            const auto begin = tape.offsets[i];
+            const auto end = tape.offsets[i + 1];
+            const auto* x = tape.operands.data() + begin;
+
+            auto& v = values[i];
+
+            if(begin == end)
+            {
+                if(positions[i] >= 0)
+                    v = X.row(positions[i]).transpose().array();
+                else v.setConstant(tape.nodes[i]->val);
+                continue;
+            }
+
+            if(c < conditionals.size() && conditionals[c] == i)
+            {
+                v = masks[c].select(values[x[0]], values[x[1]]);
+                ++c;
+                continue;
+            }
+
+            if(s < selects.size() && selects[s] == i)
+            {
+                const auto op = static_cast<SelectExpr<T>*>(tape.nodes[i])->op;
+                selectmasks[s] = comparison(op, values[x[0]], values[x[1]]);
+                v = selectmasks[s].select(values[x[2]], values[x[3]]);
+                ++s;
+                continue;
+            }
+
+            switch(tape.opcodes[i])
+            {
+                case Opcode::Identity: v = values[x[0]]; break;
+                case Opcode::Negative: v = -values[x[0]]; break;
+                case Opcode::Scale: v = tape.immediates[i] * values[x[0]]; break;
+                case Opcode::Quotient: v = values[x[0]] / tape.immediates[i]; break;
+                case Opcode::Shift: v = values[x[0]] + shifts[i]; break;
+                case Opcode::Add: v = values[x[0]] + values[x[1]]; break;
+                case Opcode::Sub: v = values[x[0]] - values[x[1]]; break;
+                case Opcode::Mul: v = values[x[0]] * values[x[1]]; break;
+                case Opcode::Div: v = values[x[0]] / values[x[1]]; break;
+                case Opcode::Sin: v = values[x[0]].sin(); break;
+                case Opcode::Cos: v = values[x[0]].cos(); break;
+                case Opcode::Tanh: v = values[x[0]].tanh(); break;
+                case Opcode::Exp: v = values[x[0]].exp(); break;
+                case Opcode::Log: v = values[x[0]].log(); break;
+                case Opcode::Sqrt: v = values[x[0]].sqrt(); break;
+                case Opcode::Sum:
+                {
+                    v.setZero();
+                    for(auto k = begin; k < end; ++k)
+                        v += values[tape.operands[k]];
+                    break;
+                }
+                case Opcode::Min: v = (values[x[0]] < values[x[1]]).select(values[x[0]], values[x[1]]); break;
+                case Opcode::Max: v = (values[x[0]] > values[x[1]]).select(values[x[0]], values[x[1]]); break;
+                default:
+                {
+                    auto* e = tape.nodes[i];
+                    for(auto l = 0; l < N; ++l)
+                    {
+                        for(auto k = begin; k < end; ++k)
+                            tape.nodes[tape.operands[k]]->val = values[tape.operands[k]][l];
+                        e->evaluate();
+                        v[l] = e->val;
+                    }
+                }
+            }
+        }
+
+        // The branches taken in the function code, decided by comparisons of expression nodes in the tape (with pack comparisons) or of other ones (one lane at a time)
+        bool others = false;
+        for(auto k = 0U; k < compared.size(); ++k)
+        {
+            const auto& [a, b] = compared[k];
+            if(a < 0 || b < 0)
+            {
+                others = true;
+                continue;
+            }
+            const auto& cmp = recording.comparisons[k];
+            consistent = consistent && comparison(cmp.op, values[a], values[b]) == cmp.val;
+        }
+        if(others)
+        {
+            for(auto l = 0; l < N; ++l)
+            {
+                for(auto k = 0U; k < recording.inputs.size(); ++k)
+                    recording.inputs[k]->val = X(k, l); // the compared expression nodes may depend on inputs not in the tape
+                for(const auto& [e, i] : feeds)
+                    e->val = values[i][l];
+                for(auto* e : recording.extras)
+                    e->evaluate();
+                for(auto k = 0U; k < compared.size(); ++k)
+                {
+                    const auto& [a, b] = compared[k];
+                    if(a >= 0 && b >= 0)
+                        continue;
+                    const auto& cmp = recording.comparisons[k];
+                    const T lval = a >= 0 ? values[a][l] : cmp.l->val;
+                    const T rval = b >= 0 ? values[b][l] : cmp.r->val;
+                    consistent[l] = consistent[l] && compare(cmp.op, lval, rval) == cmp.val;
+                }
+            }
+        }
+
+        return values[n - 1];
+    }
+
+    /// Return the values of the recorded function at N points and write its gradients at these points.
+    /// @param X The matrix whose N columns are the values of the variables at each point.
+    /// @param G The matrix whose N columns are the gradients at each point.
+    template<typename P, typename Grad>
+    auto gradient(const Eigen::MatrixBase<P>& X, Eigen::PlainObjectBase<Grad>& G) -> Pack
+    {
+        const Pack y = forward(X);
+
+        const auto& tape = recording.tape;
+        const auto n = tape.nodes.size();
+
+        adjoints.assign(n, Pack::Zero());
+        adjoints[n - 1].setOnes();
+
+        std::size_t c = conditionals.size(); // one past the next conditional expression node in the reverse sweep
+        std::size_t s = selects.size(); // one past the next select expression node in the reverse sweep
+
+        for(auto i = n; i > 0; --i)
+        {
+            const auto begin = tape.offsets[i - 1];
+            const auto end = tape.offsets[i];
+            const auto* x = tape.operands.data() + begin;
+
+            if(begin == end)
+                continue;
+
+            const Pack w = adjoints[i - 1];
+
+            if(c > 0 && conditionals[c - 1] == i - 1)
+            {
+                --c;
+                adjoints[x[0]] += masks[c].select(w, Pack::Zero());
+                adjoints[x[1]] += masks[c].select(Pack::Zero(), w);
+                continue;
+            }
+
+            if(s > 0 && selects[s - 1] == i - 1)
+            {
+                --s;
+                adjoints[x[2]] += selectmasks[s].select(w, Pack::Zero());
+                adjoints[x[3]] += selectmasks[s].select(Pack::Zero(), w);
+                continue;
+            }
+
+            if((w == 0.0).all())
+                continue;
+
+            Pack* d = buffer.data();
+
+            switch(tape.opcodes[i - 1])
+            {
+                case Opcode::Identity: d[0].setOnes(); break;
+                case Opcode::Negative: d[0].setConstant(-1.0); break;
+                case Opcode::Scale: d[0].setConstant(tape.immediates[i - 1]); break;
+                case Opcode::Quotient: d[0].setConstant(1.0 / tape.immediates[i - 1]); break;
+                case Opcode::Shift: d[0].setOnes(); break;
+                case Opcode::Add: d[0].setOnes(); d[1].setOnes(); break;
+                case Opcode::Sub: d[0].setOnes(); d[1].setConstant(-1.0); break;
+                case Opcode::Mul: d[0] = values[x[1]]; d[1] = values[x[0]]; break;
+                case Opcode::Div:
+                {
+                    const Pack aux = values[x[1]].inverse();
+                    d[0] = aux;
+                    d[1] = -values[x[0]] * aux * aux;
+                    break;
+                }
+                case Opcode::Sin: d[0] = values[x[0]].cos(); break;
+                case Opcode::Cos: d[0] = -values[x[0]].sin(); break;
+                case Opcode::Tanh: d[0] = values[x[0]].cosh().square().inverse(); break;
+                case Opcode::Exp: d[0] = values[i - 1]; break;
+                case Opcode::Log: d[0] = values[x[0]].inverse(); break;
+                case Opcode::Sqrt: d[0] = 0.5 * values[x[0]].rsqrt(); break;
+                case Opcode::Sum: std::fill(d, d + (end - begin), Pack::Ones()); break;
+                case Opcode::Min: d[0] = (values[x[0]] < values[x[1]]).template cast<T>(); d[1] = 1.0 - d[0]; break;
+                case Opcode::Max: d[0] = (values[x[0]] > values[x[1]]).template cast<T>(); d[1] = 1.0 - d[0]; break;
+                default:
+                {
+                    auto* e = tape.nodes[i - 1];
+                    for(auto l = 0; l < N; ++l)
+                    {
+                        for(auto k = begin; k < end; ++k)
+                            tape.nodes[tape.operands[k]]->val = values[tape.operands[k]][l];
+                        e->evaluate(); // the partial derivatives may depend on state computed in evaluate (e.g., in a DeterminantExpr node)
+                        e->partials(scalars.data());
+                        for(auto k = begin; k < end; ++k)
+                            d[k - begin][l] = scalars[k - begin];
+                    }
+                }
+            }
+
+            for(auto k = begin; k < end; ++k)
+                adjoints[tape.operands[k]] += w * d[k - begin];
+        }
+
+        G.resize(recording.inputs.size(), N);
+        for(auto k = 0U; k < recording.inputs.size(); ++k)
+        {
+            const auto* e = recording.inputs[k].get();
+            if(tape.contains(e))
+                G.row(k) = adjoints[e->index].transpose().matrix();
+            else G.row(k).setZero();
+        }
+
+        return y;
+    }
+};
+
+/// Return a tape with a function of many variables recorded for the given values of these variables, replayed for N points at a time (see @ref BatchTape).
+/// @param f The function with signature `var(const VectorXvar& x)` to be recorded.
+/// @param x The independent variables of the function.
+template<int N, typename Fun, typename X>
+auto record_batch(Fun&& f, const Eigen::DenseBase<X>& x)
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+    using T = std::decay_t<decltype(std::declval<ScalarX>().expr->val)>;
+    return BatchTape<T, N>(std::forward<Fun>(f), x);
+}
+
+/// The node in the expression tree representing a checkpointed region of a computation with many steps (e.g. the time steps of a simulation).
+/// Only the inputs of the region are stored. Its outputs are computed without
+/// keeping the expression trees of the steps, and in the reverse sweep, the
+/// steps are recomputed from a few intermediate states (the snapshots) and
+/// recorded one at a time, following a binomial (revolve) checkpointing schedule.
+/// With s snapshots, n steps can be reversed with at most t recomputations of
+/// each step, where t is the smallest number such that (s + t)!/(s! t!) >= n.
+template<typename T>
+struct CheckpointExpr : MultiOutputExpr<T>
+{
+    using MultiOutputExpr<T>::inputs;
+    using MultiOutputExpr<T>::values;
+
+    using State = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+    using States = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+    using Step = std::function<Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic>(std::size_t, const Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic>&)>;
+
+    /// The function that computes the state after a given step from the state before it.
+    Step step;
+
+    /// The number of steps in the checkpointed region.
+    std::size_t nsteps;
+
+    /// The number of snapshots of intermediate states that can be stored during the reverse sweep.
+    std::size_t nsnapshots;
+
+    /// Construct a CheckpointExpr object with given step function, inputs, number of steps and number of snapshots.
+    CheckpointExpr(Step f, std::vector<ExprPtr<T>> in, std::size_t n, std::size_t s)
+    : MultiOutputExpr<T>(std::move(in), 0), step(std::move(f)), nsteps(n), nsnapshots(s)
+    {
+        const State u = advance(input(), 0, nsteps);
+        values.assign(u.data(), u.data() + u.size());
+        this->outputs.resize(values.size(), nullptr);
+    }
+
+    void evaluate() override
+    {
+        const State u = advance(input(), 0, nsteps);
+        std::copy(u.data(), u.data() + u.size(), values.begin());
+    }
+
+    void vjp(const T* w, T* d) const override
+    {
+        vjps(w, d, 1);
+    }
+
+    void vjps(const T* w, T* d, std::size_t count) const override
+    {
+        // The derivatives of all root expression nodes are reversed together, so that each step is recomputed once for all of them
+        States wbar = Eigen::Map<const States>(w, values.size(), count);
+        if(nsteps > 0 && !wbar.isZero(0.0))
+            reverse(0, nsteps, input(), wbar, nsnapshots);
+        std::copy(wbar.data(), wbar.data() + wbar.size(), d);
+    }
+
+    /// Return the current values of the inputs of the checkpointed region.
+    auto input() const -> State
+    {
+        State u(inputs.size());
+        for(auto i = 0U; i < inputs.size(); ++i)
+            u[i] = inputs[i]->val;
+        return u;
+    }
+
+    /// Return the state after the steps in [begin, begin + count) given the state before them (without keeping their expression trees).
+    auto advance(State u, std::size_t begin, std::size_t count) const -> State
+    {
+        for(auto i = begin; i < begin + count; ++i)
+        {
+            ExprArena arena;
+            const Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic> v = step(i, u.template cast<Variable<T>>());
+            u.resize(v.size());
+            for(auto k = 0; k < v.size(); ++k)
+                u[k] = v[k].expr->val;
+        }
+        return u;
+    }
+
+    /// Replace the derivatives w.r.t. the state after a given step by the derivatives w.r.t. the state before it (one column for each root expression node).
+    void reverse(std::size_t i, const State& u, States& wbar) const
+    {
+        ExprArena arena;
+        const Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic> x = u.template cast<Variable<T>>();
+        const Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic> v = step(i, x);
+
+        const auto lanes = static_cast<std::size_t>(wbar.cols());
+
+        std::vector<Variable<T>> y(lanes, 0.0); // the derivatives of y[l] = wbar.col(l) . v w.r.t. x are the derivatives w.r.t. the state before the step
+        for(auto l = 0U; l < lanes; ++l)
+            for(auto k = 0; k < v.size(); ++k)
+                if(wbar(k, l) != 0.0)
+                    y[l] += wbar(k, l) * v[k];
+
+        std::vector<Expr<T>*> roots(lanes);
+        for(auto l = 0U; l < lanes; ++l)
+            roots[l] = y[l].expr.get();
+
+        Tape<T> tape;
+        tape.record(roots.data(), lanes);
+        tape.propagate(roots.data(), lanes);
+
+        wbar.resize(x.size(), lanes);
+        for(auto l = 0U; l < lanes; ++l)
+            for(auto k = 0; k < x.size(); ++k)
+                wbar(k, l) = tape.adjoint(x[k].expr.get(), l);
+
+        tape.restore(); // the step may use variables recorded in the tape being swept (whose indices are then restored)
+    }
+
+    /// Replace the derivatives w.r.t. the state after the steps in [begin, begin + count) by the derivatives w.r.t. the state before them.
+    /// @param u The state before the steps.
+    /// @param wbar The derivatives w.r.t. the state after the steps (on input) and before them (on output), one column for each root expression node.
+    /// @param s The number of snapshots available for storing intermediate states.
+    void reverse(std::size_t begin, std::size_t count, const State& u, States& wbar, std::size_t s) const
+    {
+        if(count == 1)
+            return reverse(begin, u, wbar);
+
+        if(s == 0) // no snapshots left: recompute each step from the state before the first one
+        {
+            for(auto i = count; i > 0; --i)
+                reverse(begin + i - 1, advance(u, begin, i - 1), wbar);
+            return;
+        }
+
+        // Find the smallest number of recomputations t such that beta(s, t) >= count, where beta(s, t) = (s + t)!/(s! t!)
+        auto beta = [](std::size_t ss, std::size_t tt) { double b = 1.0; for(auto k = 1U; k <= tt; ++k) b = b * (ss + k) / k; return b; };
+        std::size_t t = 1;
+        while(beta(s, t) < count)
+            ++t;
+
+        // Place the snapshot so that the last steps can be reversed with s - 1 snapshots and t recomputations
+        const auto remaining = static_cast<std::size_t>(beta(s - 1, t));
+        const auto m = count > remaining ? count - remaining : std::size_t(1);
+
+        {
+            const State snapshot = advance(u, begin, m);
+            reverse(begin + m, count - m, snapshot, wbar, s - 1);
+        }
+
+        reverse(begin, m, u, wbar, s);
+    }
+};
+
+/// Return the state of a computation after many steps as a checkpointed region, so that its memory usage in reverse mode grows only logarithmically with the number of steps.
+/// The expression trees of the steps are not kept. In the reverse sweep, they are
+/// recomputed from the inputs and at most @p nsnapshots intermediate states, which
+/// trades recomputation of steps for memory (see @ref CheckpointExpr).
+/// The step function must depend only on the state it is given (other variables
+/// it uses are treated as constants); parameters whose derivatives are needed
+/// should be appended to the state and kept unchanged by each step.
+/// @param step The function with signature `VectorXvar(std::size_t i, const VectorXvar& u)` that computes the state after step *i* from the state *u* before it.
+/// @param x The state before the first step.
+/// @param nsteps The number of steps.
+/// @param nsnapshots The number of intermediate states that can be stored during the reverse sweep (e.g., of the order of log2(nsteps)).
+template<typename Fun, typename X>
+auto checkpoint(Fun&& step, const Eigen::DenseBase<X>& x, std::size_t nsteps, std::size_t nsnapshots)
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarX>().expr->val)>;
+    static_assert(isArithmetic<T>, "Checkpointed regions support only first-order derivatives.");
+
+    std::vector<ExprPtr<T>> inputs(x.size());
+    for(auto i = 0; i < x.size(); ++i)
+        inputs[i] = x[i].expr;
+
+    auto hub = make_expr<CheckpointExpr<T>>(std::forward<Fun>(step), std::move(inputs), nsteps, nsnapshots);
+    const auto out = outputs<T>(hub);
+
+    Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic> y(out.size());
+    for(auto j = 0U; j < out.size(); ++j)
+        y[j] = Variable<T>(out[j]);
+    return y;
+}
+
+/// Return the outputs of a black-box function of a vector of variables, recorded as a single expression node with user-supplied derivatives (see @ref ExternalExpr).
+/// @param forward The callback with signature `void(const T* x, T* y)` that writes the m outputs y given the inputs x.
+/// @param pullback The callback with signature `void(const T* x, const T* y, const T* ybar, T* xbar)` that accumulates in xbar (zero on entry) the derivatives w.r.t. x of the sum of ybar[j] * y[j].
+/// @param x The inputs of the function.
+/// @param m The number of outputs of the function.
+template<typename Forward, typename Pullback, typename X>
+auto external(Forward&& forward, Pullback&& pullback, const Eigen::DenseBase<X>& x, std::size_t m)
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarX>().expr->val)>;
+    static_assert(isArithmetic<T>, "External functions support only first-order derivatives.");
+
+    std::vector<ExprPtr<T>> inputs(x.size());
+    for(auto i = 0; i < x.size(); ++i)
+        inputs[i] = x[i].expr;
+
+    auto hub = make_expr<ExternalExpr<T>>(std::forward<Forward>(forward), std::forward<Pullback>(pullback), std::move(inputs), m);
+    const auto out = outputs<T>(hub);
+
+    Vec<Variable<T>, Eigen::Dynamic, Eigen::Dynamic> y(out.size());
+    for(auto j = 0U; j < out.size(); ++j)
+        y[j] = Variable<T>(out[j]);
+    return y;
+}
+
+/// Return the current values of given expression nodes as a matrix of given size (the expression nodes are the matrix entries stored column by column).
+template<typename T>
+auto entries(const ExprPtr<T>* e, Eigen::Index rows, Eigen::Index cols) -> Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>
+{
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> M(rows, cols);
+    for(auto i = 0; i < M.size(); ++i)
+        M.data()[i] = e[i]->val;
+    return M;
+}
+
+/// Return the expression nodes of the entries of a matrix of variables, stored column by column.
+template<typename T, typename M>
+auto entrynodes(const Eigen::DenseBase<M>& A) -> std::vector<ExprPtr<T>>
+{
+    std::vector<ExprPtr<T>> nodes;
+    nodes.reserve(A.size());
+    for(auto j = 0; j < A.cols(); ++j)
+        for(auto i = 0; i < A.rows(); ++i)
+            nodes.push_back(A(i, j).expr);
+    return nodes;
+}
+
+/// The node in the expression tree representing the solution X of a linear system A X = B with a square matrix A.
+/// The child expression nodes are the entries of A followed by those of B (column by
+/// column), and the outputs are the entries of X. The matrix A is factored once, in
+/// the arithmetic type, and the factorization is kept for the reverse sweep, in which
+/// the derivatives w.r.t. B are computed with a single solve with the transpose of A,
+/// and those w.r.t. A from them (i.e., B̄ = A⁻ᵀ X̄ and Ā = -B̄ Xᵀ).
+template<typename T>
+struct SolveExpr : MultiOutputExpr<T>
+{
+    using MultiOutputExpr<T>::inputs;
+    using MultiOutputExpr<T>::values;
+
+    using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+    /// The number of rows of A (and of B).
+    Eigen::Index n;
+
+    /// The number of columns of B.
+    Eigen::Index k;
+
+    /// The LU factorization of A.
+    Eigen::PartialPivLU<Matrix> lu;
+
+    /// Construct a SolveExpr object with given entries of A followed by those of B, and number of rows and columns of B.
+    SolveExpr(std::vector<ExprPtr<T>> in, Eigen::Index rows, Eigen::Index cols)
+    : MultiOutputExpr<T>(std::move(in), rows * cols), n(rows), k(cols)
+    {
+        evaluate();
+    }
+
+    void evaluate() override
+    {
+        lu.compute(entries(inputs.data(), n, n));
+        Eigen::Map<Matrix>(values.data(), n, k) = lu.solve(entries(inputs.data() + n * n, n, k));
+    }
+
+    void vjp(const T* w, T* d) const override
+    {
+        const Eigen::Map<const Matrix> X(values.data(), n, k);
+        Eigen::Map<Matrix> Bbar(d + n * n, n, k);
+        Bbar = lu.transpose().solve(Eigen::Map<const Matrix>(w, n, k));
+        Eigen::Map<Matrix>(d, n, n) = -Bbar * X.transpose();
+    }
+};
+
+/// The node in the expression tree representing the inverse of a square matrix A.
+/// The child expression nodes are the entries of A, and the outputs are those of its
+/// inverse (column by column), with derivatives Ā = -A⁻ᵀ Ȳ A⁻ᵀ in the reverse sweep.
+template<typename T>
+struct InverseExpr : MultiOutputExpr<T>
+{
+    using MultiOutputExpr<T>::inputs;
+    using MultiOutputExpr<T>::values;
+
+    using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+    /// The number of rows and columns of A.
+    Eigen::Index n;
+
+    /// Construct an InverseExpr object with given entries of A and number of rows of A.
+    InverseExpr(std::vector<ExprPtr<T>> in, Eigen::Index rows) : MultiOutputExpr<T>(std::move(in), rows * rows), n(rows)
+    {
+        evaluate();
+    }
+
+    void evaluate() override
+    {
+        Eigen::Map<Matrix>(values.data(), n, n) = entries(inputs.data(), n, n).partialPivLu().inverse();
+    }
+
+    void vjp(const T* w, T* d) const override
+    {
+        const Eigen::Map<const Matrix> Y(values.data(), n, n);
+        Eigen::Map<Matrix>(d, n, n) = -Y.transpose() * Eigen::Map<const Matrix>(w, n, n) * Y.transpose();
+    }
+};
+
+/// The node in the expression tree representing the determinant of a square matrix A, or the logarithm of its absolute value.
+/// The child expression nodes are the entries of A, which is factored once, in the
+/// arithmetic type, with derivatives det(A) A⁻ᵀ (or A⁻ᵀ for the log-determinant).
+template<typename T>
+struct DeterminantExpr : Expr<T>
+{
+    using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+    /// The child expression nodes of this expression node (the entries of A, column by column).
+    std::vector<ExprPtr<T>> inputs;
+
+    /// The number of rows and columns of A.
+    Eigen::Index n;
+
+    /// The flag that indicates whether this is the logarithm of the absolute value of the determinant.
+    bool logarithm;
+
+    /// The LU factorization of A.
+    Eigen::PartialPivLU<Matrix> lu;
+
+    /// Construct a DeterminantExpr object with given entries of A, number of rows of A, and whether the log-determinant is computed.
+    DeterminantExpr(std::vector<ExprPtr<T>> in, Eigen::Index rows, bool log) : Expr<T>(0.0), inputs(std::move(in)), n(rows), logarithm(log)
+    {
+        evaluate();
+    }
+
+    ~DeterminantExpr() { for(auto& e : inputs) dispose(e); }
+
+    std::size_t arity() const override { return inputs.size(); }
+
+    Expr<T>* operand(std::size_t i) const override { return inputs[i].get(); }
+
+    void partials(T* d) const override
+    {
+        Eigen::Map<Matrix> D(d, n, n);
+        D = lu.inverse().transpose();
+        if(!logarithm)
+            D *= this->val;
+    }
+
+    void nonzeros2(std::vector<T>& /* h */, std::vector<std::tuple<std::size_t, std::size_t, T>>& /* entries */) const override
+    {
+        throw std::logic_error("Second-order derivatives of determinants are not supported.");
+    }
+
+    void partialsx(ExprPtr<T>* /* d */) const override
+    {
+        throw std::logic_error("Derivative expressions of determinants are not supported.");
+    }
+
+    void evaluate() override
+    {
+        lu.compute(entries(inputs.data(), n, n));
+        if(!logarithm)
+        {
+            this->val = lu.determinant();
+            return;
+        }
+        const Matrix& LU = lu.matrixLU();
+        T sum = 0.0;
+        for(auto i = 0; i < n; ++i)
+            sum += std::log(std::abs(LU(i, i)));
+        this->val = sum;
+    }
+};
+
+/// The node in the expression tree representing the lower triangular Cholesky factor L of a symmetric positive definite matrix A = L Lᵀ.
+/// The child expression nodes are the entries of A (of which only the lower triangular
+/// part is read), and the outputs are the entries on and below the diagonal of L (column
+/// by column). In the reverse sweep, the derivatives w.r.t. A are computed from L with
+/// triangular solves, as Ā = L⁻ᵀ Φ(Lᵀ L̄) L⁻¹, where Φ takes the lower triangular part
+/// with the diagonal halved, and whose upper triangular part is added to the lower one.
+template<typename T>
+struct CholeskyExpr : MultiOutputExpr<T>
+{
+    using MultiOutputExpr<T>::inputs;
+    using MultiOutputExpr<T>::values;
+
+    using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+    /// The number of rows and columns of A.
+    Eigen::Index n;
+
+    /// The Cholesky factorization of A.
+    Eigen::LLT<Matrix> llt;
+
+    /// Construct a CholeskyExpr object with given entries of A and number of rows of A.
+    CholeskyExpr(std::vector<ExprPtr<T>> in, Eigen::Index rows) : MultiOutputExpr<T>(std::move(in), rows * (rows + 1) / 2), n(rows)
+    {
+        evaluate();
+    }
+
+    void evaluate() override
+    {
+        llt.compute(entries(inputs.data(), n, n));
+        const Matrix L = llt.matrixL();
+        auto k = 0U;
+        for(auto j = 0; j < n; ++j)
+            for(auto i = j; i < n; ++i)
+                values[k++] = L(i, j);
+    }
+
+    void vjp(const T* w, T* d) const override
+    {
+        Matrix Lbar = Matrix::Zero(n, n);
+        auto k = 0U;
+        for(auto j = 0; j < n; ++j)
+            for(auto i = j; i < n; ++i)
+                Lbar(i, j) = w[k++];
+
+        const auto L = llt.matrixL();
+
+        Matrix P = (L.transpose() * Lbar).template triangularView<Eigen::Lower>();
+        P.diagonal() *= 0.5;
+
+        L.transpose().solveInPlace(P); // P = L⁻ᵀ Φ(Lᵀ L̄)
+        Matrix S = P.transpose();
+        L.transpose().solveInPlace(S); // S = (L⁻ᵀ Φ(Lᵀ L̄) L⁻¹)ᵀ
+
+        Eigen::Map<Matrix> Abar(d, n, n);
+        Abar.setZero();
+        Abar.template triangularView<Eigen::StrictlyLower>() = S + S.transpose();
+        Abar.diagonal() = S.diagonal();
+    }
+};
+
+/// Return the solution X of the linear system A X = B (or A x = b) as a single expression node (see @ref SolveExpr).
+/// This records O(n²) expression nodes, instead of the O(n³) recorded by solving the system with a decomposition of a matrix of variables.
+template<typename MA, typename MB>
+auto solve(const Eigen::DenseBase<MA>& A, const Eigen::DenseBase<MB>& B)
+{
+    using ScalarA = typename MA::Scalar;
+    static_assert(isVariable<ScalarA>, "Argument A is not a matrix with Variable<T> (aka var) objects.");
+    static_assert(isSame<ScalarA, typename MB::Scalar>, "Arguments A and B do not have the same scalar type.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarA>().expr->val)>;
+    static_assert(isArithmetic<T>, "Linear solves support only first-order derivatives.");
+
+    assert(A.rows() == A.cols());
+    assert(A.rows() == B.rows());
+
+    auto inputs = entrynodes<T>(A);
+    const auto inputsB = entrynodes<T>(B);
+    inputs.insert(inputs.end(), inputsB.begin(), inputsB.end());
+
+    auto hub = make_expr<SolveExpr<T>>(std::move(inputs), B.rows(), B.cols());
+    const auto out = outputs<T>(hub);
+
+    Mat<Variable<T>, MB::RowsAtCompileTime, MB::ColsAtCompileTime, MB::MaxRowsAtCompileTime, MB::MaxColsAtCompileTime> X(B.rows(), B.cols());
+    for(auto j = 0; j < X.cols(); ++j)
+        for(auto i = 0; i < X.rows(); ++i)
+            X(i, j) = Variable<T>(out[j * X.rows() + i]);
+    return X;
+}
+
+/// Return the inverse of a square matrix of variables, with its entries as the outputs of a single expression node (see @ref InverseExpr).
+template<typename MA>
+auto inverse(const Eigen::DenseBase<MA>& A)
+{
+    using ScalarA = typename MA::Scalar;
+    static_assert(isVariable<ScalarA>, "Argument A is not a matrix with Variable<T> (aka var) objects.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarA>().expr->val)>;
+    static_assert(isArithmetic<T>, "Matrix inverses support only first-order derivatives.");
+
+    assert(A.rows() == A.cols());
+
+    auto hub = make_expr<InverseExpr<T>>(entrynodes<T>(A), A.rows());
+    const auto out = outputs<T>(hub);
+
+    const auto n = A.rows();
+    Mat<Variable<T>, MA::RowsAtCompileTime, MA::ColsAtCompileTime, MA::MaxRowsAtCompileTime, MA::MaxColsAtCompileTime> Y(n, n);
+    for(auto j = 0; j < n; ++j)
+        for(auto i = 0; i < n; ++i)
+            Y(i, j) = Variable<T>(out[j * n + i]);
+    return Y;
+}
+
+/// Return the determinant of a square matrix of variables as a single expression node (see @ref DeterminantExpr).
+template<typename MA>
+auto determinant(const Eigen::DenseBase<MA>& A)
+{
+    using ScalarA = typename MA::Scalar;
+    static_assert(isVariable<ScalarA>, "Argument A is not a matrix with Variable<T> (aka var) objects.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarA>().expr->val)>;
+    static_assert(isArithmetic<T>, "Determinants support only first-order derivatives.");
+
+    assert(A.rows() == A.cols());
+
+    return Variable<T>(ExprPtr<T>(make_expr<DeterminantExpr<T>>(entrynodes<T>(A), A.rows(), false)));
+}
+
+/// Return the logarithm of the absolute value of the determinant of a square matrix of variables as a single expression node (see @ref DeterminantExpr).
+template<typename MA>
+auto logdet(const Eigen::DenseBase<MA>& A)
+{
+    using ScalarA = typename MA::Scalar;
+    static_assert(isVariable<ScalarA>, "Argument A is not a matrix with Variable<T> (aka var) objects.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarA>().expr->val)>;
+    static_assert(isArithmetic<T>, "Log-determinants support only first-order derivatives.");
+
+    assert(A.rows() == A.cols());
+
+    return Variable<T>(ExprPtr<T>(make_expr<DeterminantExpr<T>>(entrynodes<T>(A), A.rows(), true)));
+}
+
+/// Return the lower triangular Cholesky factor L of a symmetric positive definite matrix of variables A = L Lᵀ (see @ref CholeskyExpr).
+/// Only the lower triangular part of A is read. The entries above the diagonal of L are constant zeros.
+template<typename MA>
+auto cholesky(const Eigen::DenseBase<MA>& A)
+{
+    using ScalarA = typename MA::Scalar;
+    static_assert(isVariable<ScalarA>, "Argument A is not a matrix with Variable<T> (aka var) objects.");
+
+    using T = std::decay_t<decltype(std::declval<ScalarA>().expr->val)>;
+    static_assert(isArithmetic<T>, "Cholesky factorizations support only first-order derivatives.");
+
+    assert(A.rows() == A.cols());
+
+    auto hub = make_expr<CholeskyExpr<T>>(entrynodes<T>(A), A.rows());
+    const auto out = outputs<T>(hub);
+
+    const auto n = A.rows();
+    Mat<Variable<T>, MA::RowsAtCompileTime, MA::ColsAtCompileTime, MA::MaxRowsAtCompileTime, MA::MaxColsAtCompileTime> L(n, n);
+    auto k = 0U;
+    for(auto j = 0; j < n; ++j)
+    {
+        for(auto i = 0; i < j; ++i)
+            L(i, j) = 0.0;
+        for(auto i = j; i < n; ++i)
+            L(i, j) = Variable<T>(out[k++]);
+    }
+    return L;
+}
+
 } // namespace detail
   //
 } // namespace reverse
 
 AUTODIFF_DEFINE_EIGEN_TYPEDEFS_ALL_SIZES(autodiff::var, var)
 
+using reverse::detail::checkpoint;
+using reverse::detail::cholesky;
+using reverse::detail::determinant;
+using reverse::detail::external;
 using reverse::detail::gradient;
+using reverse::detail::record;
+using reverse::detail::sparse_hessian;
+using reverse::detail::ReplayTape;
+using reverse::detail::BatchTape;
+using reverse::detail::record_batch;
 using reverse::detail::hessian;
+using reverse::detail::hessian_vector_product;
+using reverse::detail::inverse;
+using reverse::detail::logdet;
+using reverse::detail::solve;
+using reverse::detail::jacobian;
 
 } // namespace autodiff
@@ -0,0 +1,652 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright © 2018–2024 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// C++ includes
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Eigen includes
+#include <Eigen/Core>
+
+// autodiff includes
+#include <autodiff/reverse/var/var.hpp>
+
+namespace autodiff {
+namespace reverse {
+namespace detail {
+
+template<typename T> struct MatrixExpr;
+template<typename T> struct MatrixVariable;
+
+template<typename T> using MatrixExprPtr = IntrusivePtr<MatrixExpr<T>>;
+
+template<typename T> using MatrixValue = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+/// The abstract type of any node type in the expression tree of a matrix variable.
+/// Each node holds the value of a whole matrix operation, and its derivatives
+/// are propagated with matrix operations too (e.g., a matrix product), instead
+/// of with one expression node per matrix entry.
+template<typename T>
+struct MatrixExpr : RefCounted
+{
+    /// The value of this expression node.
+    MatrixValue<T> val;
+
+    /// The position of this expression node in the last @ref MatrixTape it was recorded in.
+    std::size_t index = 0;
+
+    /// Construct a MatrixExpr object with given value.
+    explicit MatrixExpr(MatrixValue<T> v) : val(std::move(v)) {}
+
+    /// Destructor (to avoid warning)
+    virtual ~MatrixExpr() {}
+
+    /// Return the number of child expression nodes of this expression node.
+    virtual std::size_t arity() const { return 0; }
+
+    /// Return the child expression node of this expression node with given index.
+    virtual MatrixExpr<T>* operand(std::size_t /* i */) const { return nullptr; }
+
+    /// Accumulate the derivatives of the root expression node w.r.t. the child expression nodes of this expression node.
+    /// @param w The derivative of the root expression node w.r.t. this expression node (of the same size as @ref val).
+    /// @param a The derivatives of the root expression node w.r.t. each child expression node, where the contributions of this expression node are added.
+    virtual void pullback(const MatrixValue<T>& /* w */, MatrixValue<T>* const* /* a */) const {}
+
+    /// Evaluate the value of this expression node from the current values of its child expression nodes.
+    virtual void evaluate() {}
+};
+
+template<typename T>
+struct UnaryMatrixExpr : MatrixExpr<T>
+{
+    MatrixExprPtr<T> x;
+
+    UnaryMatrixExpr(MatrixValue<T> v, const MatrixExprPtr<T>& e) : MatrixExpr<T>(std::move(v)), x(e) {}
+
+    ~UnaryMatrixExpr() { dispose(x); }
+
+    std::size_t arity() const override { return 1; }
+
+    MatrixExpr<T>* operand(std::size_t /* i */) const override { return x.get(); }
+};
+
+template<typename T>
+struct BinaryMatrixExpr : MatrixExpr<T>
+{
+    MatrixExprPtr<T> l, r;
+
+    BinaryMatrixExpr(MatrixValue<T> v, const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : MatrixExpr<T>(std::move(v)), l(ll), r(rr) {}
+
+    ~BinaryMatrixExpr() { dispose(l); dispose(r); }
+
+    std::size_t arity() const override { return 2; }
+
+    MatrixExpr<T>* operand(std::size_t i) const override { return i == 0 ? l.get() : r.get(); }
+};
+
+template<typename T>
+struct MatrixNegativeExpr : UnaryMatrixExpr<T>
+{
+    using UnaryMatrixExpr<T>::x;
+
+    explicit MatrixNegativeExpr(const MatrixExprPtr<T>& e) : UnaryMatrixExpr<T>(-e->val, e) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] -= w;
+    }
+
+    void evaluate() override
+    {
+        this->val = -x->val;
+    }
+};
+
+template<typename T>
+struct MatrixAddExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixAddExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(ll->val + rr->val, ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w;
+        *a[1] += w;
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val + r->val;
+    }
+};
+
+template<typename T>
+struct MatrixSubExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixSubExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(ll->val - rr->val, ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w;
+        *a[1] -= w;
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val - r->val;
+    }
+};
+
+template<typename T>
+struct MatrixProductExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixProductExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(ll->val * rr->val, ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        a[0]->noalias() += w * r->val.transpose(); // (l * r)'l = w * r^T
+        a[1]->noalias() += l->val.transpose() * w; // (l * r)'r = l^T * w
+    }
+
+    void evaluate() override
+    {
+        this->val.noalias() = l->val * r->val;
+    }
+};
+
+template<typename T>
+struct MatrixTransposeExpr : UnaryMatrixExpr<T>
+{
+    using UnaryMatrixExpr<T>::x;
+
+    explicit MatrixTransposeExpr(const MatrixExprPtr<T>& e) : UnaryMatrixExpr<T>(e->val.transpose(), e) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w.transpose();
+    }
+
+    void evaluate() override
+    {
+        this->val = x->val.transpose();
+    }
+};
+
+/// The node in the expression tree representing the product of a matrix and a constant scalar.
+template<typename T>
+struct MatrixScaleExpr : UnaryMatrixExpr<T>
+{
+    using UnaryMatrixExpr<T>::x;
+
+    T c;
+
+    MatrixScaleExpr(const T& cc, const MatrixExprPtr<T>& e) : UnaryMatrixExpr<T>(cc * e->val, e), c(cc) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += c * w;
+    }
+
+    void evaluate() override
+    {
+        this->val = c * x->val;
+    }
+};
+
+/// The node in the expression tree representing the quotient of a matrix and a constant scalar (divided by it, instead of multiplied by its reciprocal).
+template<typename T>
+struct MatrixQuotientExpr : UnaryMatrixExpr<T>
+{
+    using UnaryMatrixExpr<T>::x;
+
+    T c;
+
+    MatrixQuotientExpr(const T& cc, const MatrixExprPtr<T>& e) : UnaryMatrixExpr<T>(e->val / cc, e), c(cc) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w / c;
+    }
+
+    void evaluate() override
+    {
+        this->val = x->val / c;
+    }
+};
+
+/// The node in the expression tree representing the product of a 1x1 matrix variable (a scalar) and a matrix.
+template<typename T>
+struct MatrixScalarProductExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixScalarProductExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(ll->val(0, 0) * rr->val, ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        (*a[0])(0, 0) += w.cwiseProduct(r->val).sum();
+        *a[1] += l->val(0, 0) * w;
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val(0, 0) * r->val;
+    }
+};
+
+template<typename T>
+struct MatrixCwiseProductExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixCwiseProductExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(ll->val.cwiseProduct(rr->val), ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w.cwiseProduct(r->val);
+        *a[1] += w.cwiseProduct(l->val);
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val.cwiseProduct(r->val);
+    }
+};
+
+template<typename T>
+struct MatrixCwiseQuotientExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::val;
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixCwiseQuotientExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(ll->val.cwiseQuotient(rr->val), ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w.cwiseQuotient(r->val);
+        *a[1] -= w.cwiseProduct(val).cwiseQuotient(r->val);
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val.cwiseQuotient(r->val);
+    }
+};
+
+/// The node in the expression tree representing the sum of the entries of a matrix (a 1x1 matrix).
+template<typename T>
+struct MatrixSumExpr : UnaryMatrixExpr<T>
+{
+    using UnaryMatrixExpr<T>::x;
+
+    explicit MatrixSumExpr(const MatrixExprPtr<T>& e) : UnaryMatrixExpr<T>(MatrixValue<T>::Constant(1, 1, e->val.sum()), e) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        a[0]->array() += w(0, 0);
+    }
+
+    void evaluate() override
+    {
+        this->val(0, 0) = x->val.sum();
+    }
+};
+
+/// The node in the expression tree representing the sum of the products of the entries of two matrices with same size (a 1x1 matrix).
+template<typename T>
+struct MatrixDotExpr : BinaryMatrixExpr<T>
+{
+    using BinaryMatrixExpr<T>::l;
+    using BinaryMatrixExpr<T>::r;
+
+    MatrixDotExpr(const MatrixExprPtr<T>& ll, const MatrixExprPtr<T>& rr) : BinaryMatrixExpr<T>(MatrixValue<T>::Constant(1, 1, ll->val.cwiseProduct(rr->val).sum()), ll, rr) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        *a[0] += w(0, 0) * r->val;
+        *a[1] += w(0, 0) * l->val;
+    }
+
+    void evaluate() override
+    {
+        this->val(0, 0) = l->val.cwiseProduct(r->val).sum();
+    }
+};
+
+/// The node in the expression tree representing a function applied to each entry of a matrix.
+/// @tparam Fun The type with static methods `value(x)` and `derivative(x, y)`, for arrays *x* of arguments and *y* of values.
+template<typename T, typename Fun>
+struct MatrixCwiseUnaryExpr : UnaryMatrixExpr<T>
+{
+    using UnaryMatrixExpr<T>::val;
+    using UnaryMatrixExpr<T>::x;
+
+    explicit MatrixCwiseUnaryExpr(const MatrixExprPtr<T>& e) : UnaryMatrixExpr<T>(Fun::value(e->val.array()).matrix(), e) {}
+
+    void pullback(const MatrixValue<T>& w, MatrixValue<T>* const* a) const override
+    {
+        a[0]->array() += w.array() * Fun::derivative(x->val.array(), val.array());
+    }
+
+    void evaluate() override
+    {
+        this->val = Fun::value(x->val.array()).matrix();
+    }
+};
+
+struct MatrixSinFun  { template<typename X> static auto value(const X& x) { return x.sin(); }    template<typename X, typename Y> static auto derivative(const X& x, const Y&  ) { return x.cos(); } };
+struct MatrixCosFun  { template<typename X> static auto value(const X& x) { return x.cos(); }    template<typename X, typename Y> static auto derivative(const X& x, const Y&  ) { return -x.sin(); } };
+struct MatrixTanhFun { template<typename X> static auto value(const X& x) { return x.tanh(); }   template<typename X, typename Y> static auto derivative(const X&  , const Y& y) { return 1.0 - y.square(); } };
+struct MatrixExpFun  { template<typename X> static auto value(const X& x) { return x.exp(); }    template<typename X, typename Y> static auto derivative(const X&  , const Y& y) { return y; } };
+struct MatrixLogFun  { template<typename X> static auto value(const X& x) { return x.log(); }    template<typename X, typename Y> static auto derivative(const X& x, const Y&  ) { return x.inverse(); } };
+struct MatrixSqrtFun { template<typename X> static auto value(const X& x) { return x.sqrt(); }   template<typename X, typename Y> static auto derivative(const X&  , const Y& y) { return 0.5 * y.inverse(); } };
+struct MatrixSquareFun { template<typename X> static auto value(const X& x) { return x.square(); } template<typename X, typename Y> static auto derivative(const X& x, const Y&  ) { return 2.0 * x; } };
+
+/// The topologically ordered list of the expression nodes in the expression tree of a matrix variable (see @ref Tape).
+template<typename T>
+struct MatrixTape
+{
+    /// The expression nodes in topological order (child expression nodes before their parents).
+    std::vector<MatrixExpr<T>*> nodes;
+
+    /// The positions in @ref operands where the child node indices of each expression node start.
+    std::vector<std::size_t> offsets;
+
+    /// The indices in @ref nodes of the child expression nodes of each expression node.
+    std::vector<std::size_t> operands;
+
+    /// The derivatives of the root expression node w.r.t. each expression node in the tape (the adjoints).
+    std::vector<MatrixValue<T>> adjoints;
+
+    /// The auxiliary array of pointers to the adjoints of the child expression nodes of an expression node.
+    std::vector<MatrixValue<T>*> buffer;
+
+    /// The auxiliary stack used in the depth-first traversal of the expression tree.
+    std::vector<std::pair<MatrixExpr<T>*, bool>> stack;
+
+    /// Construct a MatrixTape object with the expression nodes in the expression tree of a given root node.
+    explicit MatrixTape(MatrixExpr<T>* root)
+    {
+        offsets.assign(1, 0);
+        stack.emplace_back(root, false);
+
+        std::size_t maxarity = 0;
+
+        while(!stack.empty())
+        {
+            const auto [e, visited] = stack.back();
+            stack.pop_back();
+
+            if(contains(e))
+                continue;
+
+            const auto arity = e->arity();
+
+            if(visited) // all child expression nodes of e are in the tape already
+            {
+                for(auto i = 0U; i < arity; ++i)
+                    operands.push_back(e->operand(i)->index);
+                offsets.push_back(operands.size());
+                e->index = nodes.size();
+                nodes.push_back(e);
+                maxarity = std::max(maxarity, arity);
+                continue;
+            }
+
+            stack.emplace_back(e, true);
+
+            for(auto i = arity; i > 0; --i)
+                if(!contains(e->operand(i - 1)))
+                    stack.emplace_back(e->operand(i - 1), false);
+        }
+
+        buffer.resize(maxarity);
+    }
+
+    /// Return true if a given expression node has been recorded in this tape.
+    bool contains(const MatrixExpr<T>* e) const
+    {
+        return e->index < nodes.size() && nodes[e->index] == e;
+    }
+
+    /// Return the derivative of the root expression node w.r.t. a given expression node (zero if not in the tape).
+    MatrixValue<T> adjoint(const MatrixExpr<T>* e) const
+    {
+        return contains(e) ? adjoints[e->index] : MatrixValue<T>::Zero(e->val.rows(), e->val.cols());
+    }
+
+    /// Update the values of all expression nodes in the tape, in topological order.
+    void update()
+    {
+        for(auto* e : nodes)
+            e->evaluate();
+    }
+
+    /// Compute the derivatives of the root expression node w.r.t. every expression node in the tape in a single reverse sweep.
+    /// @param wprime The derivative of the final root expression node w.r.t. the root expression node of the tape.
+    void propagate(const MatrixValue<T>& wprime)
+    {
+        const auto n = nodes.size();
+
+        adjoints.resize(n);
+        for(auto i = 0U; i < n; ++i)
+            adjoints[i].setZero(nodes[i]->val.rows(), nodes[i]->val.cols());
+
+        if(n == 0)
+            return;
+
+        adjoints[n - 1] = wprime;
+
+        for(auto i = n; i > 0; --i)
+        {
+            const auto begin = offsets[i - 1];
+            const auto end = offsets[i];
+
+            if(begin == end)
+                continue;
+
+            for(auto k = begin; k < end; ++k)
+                buffer[k - begin] = &adjoints[operands[k]];
+
+            nodes[i - 1]->pullback(adjoints[i - 1], buffer.data());
+        }
+    }
+};
+
+/// The matrix variable type used for reverse mode automatic differentiation of matrix computations.
+/// Each operation on matrix variables (e.g., a matrix product) creates a single
+/// expression node, whose derivatives are computed with matrix operations too,
+/// instead of one scalar @ref Variable expression node per entry of the result.
+/// Scalar results (e.g., @ref sum and @ref dot) are 1x1 matrix variables.
+template<typename T>
+struct MatrixVariable
+{
+    /// The pointer to the expression tree of matrix operations
+    MatrixExprPtr<T> expr;
+
+    /// Construct a default MatrixVariable object (an empty matrix)
+    MatrixVariable() : MatrixVariable(MatrixValue<T>()) {}
+
+    /// Construct a MatrixVariable object with given matrix value (an independent matrix variable)
+    template<typename Derived>
+    MatrixVariable(const Eigen::MatrixBase<Derived>& m) : expr(make_expr<MatrixExpr<T>>(MatrixValue<T>(m))) {}
+
+    /// Construct a MatrixVariable object with given expression
+    template<typename E, Requires<std::is_base_of_v<MatrixExpr<T>, E>> = true>
+    MatrixVariable(const IntrusivePtr<E>& e) : expr(e) {}
+
+    /// Return the number of rows of this matrix variable.
+    auto rows() const { return expr->val.rows(); }
+
+    /// Return the number of columns of this matrix variable.
+    auto cols() const { return expr->val.cols(); }
+
+    /// Return the number of entries of this matrix variable.
+    auto size() const { return expr->val.size(); }
+
+    /// Return the transpose of this matrix variable.
+    auto transpose() const -> MatrixVariable { return make_expr<MatrixTransposeExpr<T>>(expr); }
+
+    /// Return the entrywise product of this matrix variable and another one.
+    auto cwiseProduct(const MatrixVariable& other) const -> MatrixVariable { return make_expr<MatrixCwiseProductExpr<T>>(expr, other.expr); }
+
+    /// Return the entrywise quotient of this matrix variable and another one.
+    auto cwiseQuotient(const MatrixVariable& other) const -> MatrixVariable { return make_expr<MatrixCwiseQuotientExpr<T>>(expr, other.expr); }
+
+    /// Return the sum of the entries of this matrix variable (as a 1x1 matrix variable).
+    auto sum() const -> MatrixVariable { return make_expr<MatrixSumExpr<T>>(expr); }
+
+    /// Return the sum of the products of the entries of this matrix variable and another one (as a 1x1 matrix variable).
+    auto dot(const MatrixVariable& other) const -> MatrixVariable { return make_expr<MatrixDotExpr<T>>(expr, other.expr); }
+
+    /// Return the sum of the squares of the entries of this matrix variable (as a 1x1 matrix variable).
+    auto squaredNorm() const -> MatrixVariable { return make_expr<MatrixDotExpr<T>>(expr, expr); }
+
+    /// Update the value of this matrix variable (if it is an independent matrix variable).
+    template<typename Derived>
+    void update(const Eigen::MatrixBase<Derived>& m)
+    {
+        if(expr->arity() != 0)
+            throw std::logic_error("Cannot update the value of a dependent expression stored in a matrix variable");
+        expr->val = m;
+    }
+
+    /// Update the value of this matrix variable after changes in its dependent matrix variables.
+    void update()
+    {
+        MatrixTape<T>(expr.get()).update();
+    }
+
+    MatrixVariable& operator+=(const MatrixVariable& other) { expr = make_expr<MatrixAddExpr<T>>(expr, other.expr); return *this; }
+    MatrixVariable& operator-=(const MatrixVariable& other) { expr = make_expr<MatrixSubExpr<T>>(expr, other.expr); return *this; }
+    MatrixVariable& operator*=(const MatrixVariable& other) { expr = (*this * other).expr; return *this; }
+    MatrixVariable& operator*=(const T& c) { expr = make_expr<MatrixScaleExpr<T>>(c, expr); return *this; }
+};
+
+//------------------------------------------------------------------------------
+// ARITHMETIC OPERATORS (DEFINED FOR ARGUMENTS OF TYPE MatrixVariable)
+//------------------------------------------------------------------------------
+template<typename T> MatrixVariable<T> operator+(const MatrixVariable<T>& r) { return r; }
+template<typename T> MatrixVariable<T> operator-(const MatrixVariable<T>& r) { return make_expr<MatrixNegativeExpr<T>>(r.expr); }
+
+template<typename T> MatrixVariable<T> operator+(const MatrixVariable<T>& l, const MatrixVariable<T>& r) { return make_expr<MatrixAddExpr<T>>(l.expr, r.expr); }
+template<typename T> MatrixVariable<T> operator-(const MatrixVariable<T>& l, const MatrixVariable<T>& r) { return make_expr<MatrixSubExpr<T>>(l.expr, r.expr); }
+
+/// Return the product of two matrix variables (or of a 1x1 matrix variable and a matrix variable of any size).
+template<typename T>
+MatrixVariable<T> operator*(const MatrixVariable<T>& l, const MatrixVariable<T>& r)
+{
+    if(l.cols() != r.rows() && l.size() == 1)
+        return make_expr<MatrixScalarProductExpr<T>>(l.expr, r.expr);
+    if(l.cols() != r.rows() && r.size() == 1)
+        return make_expr<MatrixScalarProductExpr<T>>(r.expr, l.expr);
+    return make_expr<MatrixProductExpr<T>>(l.expr, r.expr);
+}
+
+template<typename T, typename U, Requires<isArithmetic<U>> = true> MatrixVariable<T> operator*(const U& c, const MatrixVariable<T>& r) { return make_expr<MatrixScaleExpr<T>>(static_cast<T>(c), r.expr); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> MatrixVariable<T> operator*(const MatrixVariable<T>& l, const U& c) { return make_expr<MatrixScaleExpr<T>>(static_cast<T>(c), l.expr); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> MatrixVariable<T> operator/(const MatrixVariable<T>& l, const U& c) { return make_expr<MatrixQuotientExpr<T>>(static_cast<T>(c), l.expr); }
+
+// Constant matrices (e.g., Eigen::MatrixXd objects) are converted to matrix variables without derivatives
+template<typename T, typename Derived> MatrixVariable<T> operator+(const MatrixVariable<T>& l, const Eigen::MatrixBase<Derived>& r) { return l + MatrixVariable<T>(r); }
+template<typename T, typename Derived> MatrixVariable<T> operator+(const Eigen::MatrixBase<Derived>& l, const MatrixVariable<T>& r) { return MatrixVariable<T>(l) + r; }
+template<typename T, typename Derived> MatrixVariable<T> operator-(const MatrixVariable<T>& l, const Eigen::MatrixBase<Derived>& r) { return l - MatrixVariable<T>(r); }
+template<typename T, typename Derived> MatrixVariable<T> operator-(const Eigen::MatrixBase<Derived>& l, const MatrixVariable<T>& r) { return MatrixVariable<T>(l) - r; }
+template<typename T, typename Derived> MatrixVariable<T> operator*(const MatrixVariable<T>& l, const Eigen::MatrixBase<Derived>& r) { return l * MatrixVariable<T>(r); }
+template<typename T, typename Derived> MatrixVariable<T> operator*(const Eigen::MatrixBase<Derived>& l, const MatrixVariable<T>& r) { return MatrixVariable<T>(l) * r; }
+
+//------------------------------------------------------------------------------
+// ENTRYWISE FUNCTIONS (DEFINED FOR ARGUMENTS OF TYPE MatrixVariable)
+//------------------------------------------------------------------------------
+template<typename T> MatrixVariable<T> sin(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixSinFun>>(x.expr); }
+template<typename T> MatrixVariable<T> cos(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixCosFun>>(x.expr); }
+template<typename T> MatrixVariable<T> tanh(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixTanhFun>>(x.expr); }
+template<typename T> MatrixVariable<T> exp(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixExpFun>>(x.expr); }
+template<typename T> MatrixVariable<T> log(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixLogFun>>(x.expr); }
+template<typename T> MatrixVariable<T> sqrt(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixSqrtFun>>(x.expr); }
+template<typename T> MatrixVariable<T> square(const MatrixVariable<T>& x) { return make_expr<MatrixCwiseUnaryExpr<T, MatrixSquareFun>>(x.expr); }
+
+//------------------------------------------------------------------------------
+// CONVENIENT FUNCTIONS (DEFINED FOR ARGUMENTS OF TYPE MatrixVariable)
+//------------------------------------------------------------------------------
+
+/// Return the value of a matrix variable.
+template<typename T>
+auto val(const MatrixVariable<T>& x) -> const MatrixValue<T>& { return x.expr->val; }
+
+/// Return the derivatives of a 1x1 matrix variable y with respect to given matrix variables.
+template<typename T, typename... Vars>
+auto derivatives(const MatrixVariable<T>& y, const Wrt<Vars...>& wrt)
+{
+    if(y.size() != 1)
+        throw std::logic_error("Derivatives are computed only for 1x1 matrix variables (e.g., the result of sum or dot)");
+
+    constexpr auto N = sizeof...(Vars);
+    std::array<MatrixValue<T>, N> values;
+
+    MatrixTape<T> tape(y.expr.get());
+    tape.propagate(MatrixValue<T>::Ones(1, 1));
+
+    For<N>([&](auto i) constexpr {
+        values.at(i) = tape.adjoint(std::get<i>(wrt.args).expr.get());
+    });
+
+    return values;
+}
+
+/// Return the derivative of a 1x1 matrix variable y with respect to a matrix variable x (of the same size as x).
+template<typename T>
+auto gradient(const MatrixVariable<T>& y, const MatrixVariable<T>& x) -> MatrixValue<T>
+{
+    return derivatives(y, wrt(x))[0];
+}
+
+} // namespace detail
+} // namespace reverse
+
+using reverse::detail::MatrixVariable;
+
+using matvar = MatrixVariable<double>;
+
+} // namespace autodiff
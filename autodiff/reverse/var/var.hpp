@@ -30,13 +30,22 @@
 #pragma once
 
 // C++ includes
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 // autodiff includes
 #include <autodiff/common/meta.hpp>
@@ -48,9 +57,11 @@ namespace autodiff {}
 namespace autodiff {
 // avoid clash with autodiff::detail in autodiff/forward/dual/dual.hpp
 namespace reverse {
-using detail::Requires;
-using detail::For;
-using detail::isArithmetic;
+using autodiff::detail::Requires;
+using autodiff::detail::For;
+using autodiff::detail::isArithmetic;
+using autodiff::detail::isSame;
+using autodiff::detail::PlainType;
 namespace detail {
 
 
@@ -80,6 +91,9 @@ template<typename T> struct DependentVariableExpr;
 template<typename T> struct ConstantExpr;
 template<typename T> struct UnaryExpr;
 template<typename T> struct NegativeExpr;
+template<typename T> struct ScaleExpr;
+template<typename T> struct QuotientExpr;
+template<typename T> struct ShiftExpr;
 template<typename T> struct BinaryExpr;
 template<typename T> struct TernaryExpr;
 template<typename T> struct AddExpr;
@@ -105,9 +119,19 @@ template<typename T> struct AbsExpr;
 template<typename T> struct ErfExpr;
 template<typename T> struct Hypot2Expr;
 template<typename T> struct Hypot3Expr;
+template<typename T> struct SumExpr;
+template<typename T> struct DotExpr;
+template<typename T> struct PreaccumulatedExpr;
+template<typename T> struct SelectExpr;
+template<typename T> struct MinExpr;
+template<typename T> struct MaxExpr;
+template<typename T> struct SgnExpr;
 template<typename T> struct Variable;
+template<typename T> struct Tape;
 
-template<typename T> using ExprPtr = std::shared_ptr<Expr<T>>;
+template<typename E> struct IntrusivePtr;
+
+template<typename T> using ExprPtr = IntrusivePtr<Expr<T>>;
 
 namespace traits {
 
@@ -149,13 +173,386 @@ constexpr auto VariableOrder = traits::VariableOrder<T>::value;
 template<typename T>
 constexpr auto isVariable = traits::isVariable<T>::value;
 
+/// The memory blocks of an @ref ExprArena, from which expression nodes are bump-allocated.
+/// The blocks are released at once when both the arena has been destroyed and
+/// the last expression node allocated from them has been destroyed.
+struct ArenaMemory
+{
+    /// The allocated memory blocks.
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+
+    /// The beginning of the unused memory in the last allocated block.
+    std::byte* top = nullptr;
+
+    /// The number of unused bytes in the last allocated block.
+    std::size_t available = 0;
+
+    /// The size of each allocated memory block (in bytes).
+    std::size_t blocksize = 0;
+
+    /// The number of allocations not yet deallocated.
+    std::size_t count = 0;
+
+    /// The flag indicating whether the arena owning this memory has been destroyed.
+    bool released = false;
+
+    /// Construct an ArenaMemory object with given block size (in bytes).
+    explicit ArenaMemory(std::size_t size) : blocksize(size) {}
+
+    /// Return a pointer to a memory region with given size and alignment.
+    void* allocate(std::size_t size, std::size_t alignment)
+    {
+        const auto padding = (alignment - reinterpret_cast<std::uintptr_t>(top) % alignment) % alignment;
+        if(top == nullptr || padding + size > available)
+        {
+            const auto bytes = std::max(blocksize, size + alignment);
+            blocks.emplace_back(new std::byte[bytes]);
+            top = blocks.back().get();
+            available = bytes;
+            return allocate(size, alignment);
+        }
+        void* ptr = top + padding;
+        top += padding + size;
+        available -= padding + size;
+        ++count;
+        return ptr;
+    }
+
+    /// Register the deallocation of a memory region (the memory is only reclaimed with the whole arena).
+    void deallocate()
+    {
+        assert(count > 0);
+        if(--count == 0 && released)
+            delete this;
+    }
+
+    /// Mark this memory as no longer in use by its arena (deleting it if no allocation is alive).
+    void release()
+    {
+        released = true;
+        if(count == 0)
+            delete this;
+    }
+
+    /// Return the memory of the active arena in the current thread (nullptr if there is none).
+    static ArenaMemory*& current()
+    {
+        static thread_local ArenaMemory* memory = nullptr;
+        return memory;
+    }
+};
+
+/// The base type of objects (e.g., expression nodes) owned by @ref IntrusivePtr handles, with their reference count embedded in them.
+/// The reference count is not atomic, since expression trees are recorded and
+/// swept in a single thread, so that copying handles costs a plain increment.
+/// Define the macro AUTODIFF_ENABLE_ATOMIC_REFCOUNT if expression nodes are
+/// shared among threads (e.g., expression trees recorded in one thread and
+/// destroyed in another), to make the reference count atomic.
+struct RefCounted
+{
+#if defined(AUTODIFF_ENABLE_ATOMIC_REFCOUNT)
+    using Count = std::atomic<std::size_t>;
+#else
+    using Count = std::size_t;
+#endif
+
+    /// The number of handles referring to this object.
+    mutable Count refs = 0;
+
+    /// The memory of the @ref ExprArena where this object was allocated (nullptr if allocated in the heap).
+    ArenaMemory* memory = nullptr;
+
+    RefCounted() = default;
+
+    RefCounted(const RefCounted&) : RefCounted() {}
+
+    RefCounted& operator=(const RefCounted&) { return *this; }
+
+    virtual ~RefCounted() {}
+
+    /// Register a new handle referring to this object.
+    void acquire() const { ++refs; }
+
+    /// Unregister a handle referring to this object, destroying it if it was the last one.
+    void release() const
+    {
+        if(--refs != 0)
+            return;
+        if(auto* arena = memory)
+        {
+            this->~RefCounted();
+            arena->deallocate();
+        }
+        else delete this;
+    }
+};
+
+/// The handle type of objects derived from @ref RefCounted (e.g., expression nodes), with shared ownership as in std::shared_ptr.
+template<typename E>
+struct IntrusivePtr
+{
+    /// The object referred to by this handle (nullptr if none).
+    E* ptr = nullptr;
+
+    IntrusivePtr() = default;
+
+    IntrusivePtr(std::nullptr_t) {}
+
+    /// Construct an IntrusivePtr object referring to a given object (sharing its ownership with existing handles, if any).
+    explicit IntrusivePtr(E* p) : ptr(p) { if(ptr) ptr->acquire(); }
+
+    IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.ptr) {}
+
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+
+    template<typename F, Requires<std::is_convertible_v<F*, E*>> = true>
+    IntrusivePtr(const IntrusivePtr<F>& other) : IntrusivePtr(other.ptr) {}
+
+    template<typename F, Requires<std::is_convertible_v<F*, E*>> = true>
+    IntrusivePtr(IntrusivePtr<F>&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+
+    ~IntrusivePtr() { reset(); }
+
+    IntrusivePtr& operator=(const IntrusivePtr& other) { IntrusivePtr(other).swap(*this); return *this; }
+
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept { IntrusivePtr(std::move(other)).swap(*this); return *this; }
+
+    /// Release the object referred to by this handle (destroying it if this was its last handle).
+    void reset()
+    {
+        if(auto* p = ptr)
+        {
+            ptr = nullptr; // detached first, in case the destruction of the object reaches this handle
+            p->release();
+        }
+    }
+
+    void swap(IntrusivePtr& other) noexcept { std::swap(ptr, other.ptr); }
+
+    E* get() const { return ptr; }
+
+    E* operator->() const { return ptr; }
+
+    E& operator*() const { return *ptr; }
+
+    explicit operator bool() const { return ptr != nullptr; }
+
+    /// Return the number of handles referring to the object referred to by this handle (zero if none).
+    std::size_t use_count() const { return ptr ? std::size_t(ptr->refs) : 0; }
+};
+
+template<typename E, typename F> bool operator==(const IntrusivePtr<E>& l, const IntrusivePtr<F>& r) { return l.get() == r.get(); }
+template<typename E, typename F> bool operator!=(const IntrusivePtr<E>& l, const IntrusivePtr<F>& r) { return l.get() != r.get(); }
+template<typename E> bool operator==(const IntrusivePtr<E>& l, std::nullptr_t) { return !l; }
+template<typename E> bool operator!=(const IntrusivePtr<E>& l, std::nullptr_t) { return bool(l); }
+
+/// The memory arena in which all expression nodes are allocated while it is alive (in the thread it was created).
+/// Expression nodes created during the lifetime of an ExprArena object (the
+/// recording session) are bump-allocated contiguously in large memory blocks,
+/// instead of one heap allocation per node. These blocks are released at once
+/// when the arena is destroyed. Expression nodes that are still referenced by
+/// variables after that keep the blocks alive until they are destroyed too.
+/// Expression nodes allocated in an arena must be destroyed in the thread that created it.
+struct ExprArena
+{
+    /// The memory of this arena.
+    ArenaMemory* memory;
+
+    /// The memory of the arena that was active before this one.
+    ArenaMemory* previous;
+
+    /// Construct an ExprArena object with given block size (in bytes) and make it the active arena.
+    explicit ExprArena(std::size_t blocksize = 65536) : memory(new ArenaMemory(blocksize)), previous(ArenaMemory::current())
+    {
+        ArenaMemory::current() = memory;
+    }
+
+    ExprArena(const ExprArena&) = delete;
+
+    ExprArena& operator=(const ExprArena&) = delete;
+
+    /// Destroy this ExprArena object, restoring the previously active arena.
+    ~ExprArena()
+    {
+        assert(ArenaMemory::current() == memory && "ExprArena objects must be destroyed in the reverse order of their creation.");
+        ArenaMemory::current() = previous;
+        memory->release();
+    }
+};
+
+/// Create an expression node of given type (in the active @ref ExprArena, if any).
+template<typename E, typename... Args>
+auto make_expr(Args&&... args) -> IntrusivePtr<E>
+{
+    if(auto* memory = ArenaMemory::current())
+    {
+        void* ptr = memory->allocate(sizeof(E), alignof(E));
+        E* e = nullptr;
+        try { e = new(ptr) E(std::forward<Args>(args)...); }
+        catch(...) { memory->deallocate(); throw; }
+        e->memory = memory;
+        return IntrusivePtr<E>(e);
+    }
+    return IntrusivePtr<E>(new E(std::forward<Args>(args)...));
+}
+
+/// The key identifying an expression node in an @ref ExprCache.
+/// It consists of the type of the expression node, the addresses of its child
+/// expression nodes and, for expression nodes without child expression nodes
+/// (i.e., constants), their value. Values are compared bit by bit, so that,
+/// e.g., the constants -0.0 and 0.0 are different expression nodes.
+struct ExprKey
+{
+    /// The address identifying the type of the expression node.
+    const void* type = nullptr;
+
+    /// The addresses of the child expression nodes.
+    std::array<const void*, 3> operands = {};
+
+    /// The bytes of the value of the expression node if it has no child expression nodes (i.e., a constant), or else of the constant stored in it (e.g., in a @ref ScaleExpr).
+    std::array<char, sizeof(long double)> value = {};
+
+    /// Set the value in this key.
+    template<typename T>
+    void assign(const T& v)
+    {
+        static_assert(sizeof(T) <= sizeof(value));
+        std::memcpy(value.data(), &v, sizeof(T));
+    }
+
+    bool operator==(const ExprKey& other) const { return type == other.type && operands == other.operands && value == other.value; }
+};
+
+/// The hash function of @ref ExprKey objects.
+struct ExprKeyHash
+{
+    std::size_t operator()(const ExprKey& key) const
+    {
+        auto seed = std::hash<const void*>()(key.type);
+        auto combine = [&](std::size_t h) { seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+        for(const auto* operand : key.operands)
+            combine(std::hash<const void*>()(operand));
+        combine(std::hash<std::string_view>()(std::string_view(key.value.data(), key.value.size())));
+        return seed;
+    }
+};
+
+/// The table of expression nodes of an @ref ExprCache, indexed by their @ref ExprKey.
+struct ExprTable
+{
+    /// The expression nodes created while the cache is active (kept alive by the table).
+    std::unordered_map<ExprKey, IntrusivePtr<RefCounted>, ExprKeyHash> nodes;
+
+    /// Return the table of the active cache in the current thread (nullptr if there is none).
+    static ExprTable*& current()
+    {
+        static thread_local ExprTable* table = nullptr;
+        return table;
+    }
+};
+
+/// The recording mode in which structurally identical expression nodes are created only once (hash-consing).
+/// While an ExprCache object is alive (in the thread it was created), operations
+/// whose type, child expression nodes (and, for constants, value) are the same as
+/// those of an expression node created before return that expression node, instead
+/// of a new one. For example, `sin(theta)` computed in several places of a model
+/// results in a single expression node, as do `x * y` and `y * x`. This shrinks the
+/// expression tree and the cost of all later sweeps over it (e.g., in replayed tapes).
+/// The expression nodes created while the cache is active are kept alive until it is destroyed.
+struct ExprCache
+{
+    /// The expression nodes of this cache.
+    ExprTable table;
+
+    /// The table of the cache that was active before this one.
+    ExprTable* previous;
+
+    /// Construct an ExprCache object and make it the active cache.
+    ExprCache() : previous(ExprTable::current())
+    {
+        ExprTable::current() = &table;
+    }
+
+    ExprCache(const ExprCache&) = delete;
+
+    ExprCache& operator=(const ExprCache&) = delete;
+
+    /// Destroy this ExprCache object, restoring the previously active cache.
+    ~ExprCache()
+    {
+        assert(ExprTable::current() == &table && "ExprCache objects must be destroyed in the reverse order of their creation.");
+        ExprTable::current() = previous;
+    }
+};
+
+/// The address identifying an expression node type in an @ref ExprKey.
+template<typename E>
+struct ExprType { static constexpr char tag = 0; };
+
+/// The trait indicating whether an expression node type is commutative in its two child expression nodes.
+template<typename E> struct Commutative : std::false_type {};
+template<typename T> struct Commutative<AddExpr<T>> : std::true_type {};
+template<typename T> struct Commutative<MulExpr<T>> : std::true_type {};
+
+/// Create an expression node of given type with given value and arguments (or return the identical one in the active @ref ExprCache, if any).
+/// The arguments are the child expression nodes of the expression node, possibly followed by a constant of type T stored in it (e.g., in a @ref ScaleExpr).
+template<typename E, typename T, typename... Args>
+auto make_cached_expr(const T& val, const Args&... args) -> IntrusivePtr<E>
+{
+    constexpr auto immediates = (std::size_t(isSame<Args, T>) + ... + 0);
+    constexpr auto operands = sizeof...(Args) - immediates;
+
+    static_assert(operands <= 3 && immediates <= 1);
+
+    auto* table = ExprTable::current();
+
+    if constexpr((operands == 0 || immediates > 0) && !isArithmetic<T>)
+        table = nullptr; // constants are identified by their value, which must be arithmetic
+
+    if(!table)
+        return make_expr<E>(val, args...);
+
+    ExprKey key;
+    key.type = &ExprType<E>::tag;
+    std::size_t i = 0;
+    [[maybe_unused]] auto insert = [&](const auto& arg)
+    {
+        if constexpr(isSame<PlainType<decltype(arg)>, T>)
+            key.assign(arg);
+        else key.operands[i++] = arg.get();
+    };
+    (insert(args), ...);
+    if constexpr(operands == 0)
+        key.assign(val);
+    if constexpr(Commutative<E>::value)
+        if(std::less<const void*>()(key.operands[1], key.operands[0]))
+            std::swap(key.operands[0], key.operands[1]);
+
+    auto& node = table->nodes[key];
+    if(!node)
+        node = make_expr<E>(val, args...);
+    auto* e = static_cast<E*>(node.get());
+    e->val = val; // the child expression nodes may have been updated since the node was created (e.g., in a replayed tape)
+    return IntrusivePtr<E>(e);
+}
+
+/// The operation codes of the expression node types whose partial derivatives are computed in a @ref Tape without virtual calls.
+enum class Opcode : std::uint8_t
+{
+    Generic, ///< The partial derivatives are computed with @ref Expr::partials.
+    Identity, Negative, Scale, Quotient, Shift, Add, Sub, Mul, Div, Sin, Cos, Tanh, Exp, Log, Sqrt, Sum, Min, Max
+};
+
 /// The abstract type of any node type in the expression tree.
 template<typename T>
-struct Expr
+struct Expr : RefCounted
 {
     /// The value of this expression node.
     T val = {};
 
+    /// The position of this expression node in the last @ref Tape it was recorded in.
+    std::size_t index = 0;
+
     /// Construct an Expr object with given value.
     explicit Expr(const T& v) : val(v) {}
 
@@ -168,18 +565,136 @@ struct Expr
     /// Bind an expression pointer for writing the derivative expression during propagation
     virtual void bind_expr(ExprPtr<T>* /* gradx */) {}
 
+    /// Return the number of child expression nodes of this expression node.
+    virtual std::size_t arity() const { return 0; }
+
+    /// Return the child expression node of this expression node with given index.
+    virtual Expr<T>* operand(std::size_t /* i */) const { return nullptr; }
+
+    /// Write the partial derivatives of this expression node w.r.t. each of its child expression nodes.
+    /// @param d The array of size @ref arity where the partial derivatives are written.
+    virtual void partials(T* /* d */) const {}
+
+    /// Write the second-order partial derivatives of this expression node w.r.t. each pair of its child expression nodes.
+    /// The default implementation is for expression nodes that are linear in their child expression nodes.
+    /// @param h The array of size @ref arity × @ref arity where the second-order partial derivatives are written (row by row).
+    virtual void partials2(T* h) const
+    {
+        std::fill(h, h + arity() * arity(), T(0.0));
+    }
+
+    /// Append the nonzero second-order partial derivatives of this expression node w.r.t. pairs of its child expression nodes.
+    /// Each entry (a, b, value), with a <= b, refers to the positions of the two child
+    /// expression nodes. The default implementation collects the nonzero entries written
+    /// by @ref partials2, and is overridden by expression nodes with many child
+    /// expression nodes (e.g., @ref SumExpr), whose second-order partial derivatives are sparse.
+    /// @param h The auxiliary array used by the default implementation (resized to @ref arity × @ref arity if needed).
+    /// @param entries The list where the nonzero entries are appended.
+    virtual void nonzeros2(std::vector<T>& h, std::vector<std::tuple<std::size_t, std::size_t, T>>& entries) const
+    {
+        const auto n = arity();
+        if(h.size() < n * n)
+            h.resize(n * n);
+        partials2(h.data());
+        for(auto a = 0U; a < n; ++a)
+            for(auto b = a; b < n; ++b)
+                if(h[a * n + b] != 0.0)
+                    entries.emplace_back(a, b, h[a * n + b]);
+    }
+
+    /// Write the partial derivatives of this expression node w.r.t. each of its child expression nodes (as expressions).
+    /// A null expression pointer in @p d denotes a unit partial derivative.
+    /// @param d The array of size @ref arity where the partial derivative expressions are written.
+    virtual void partialsx(ExprPtr<T>* /* d */) const {}
+
+    /// Accumulate the derivative of the root expression node w.r.t. this expression node in its bound value pointer (if any).
+    virtual void accumulate(const T& /* wprime */) {}
+
+    /// Accumulate the derivative expression of the root expression node w.r.t. this expression node in its bound expression pointer (if any).
+    virtual void accumulatex(const ExprPtr<T>& /* wprime */) {}
+
+    /// Evaluate the value of this expression node from the current values of its child expression nodes.
+    virtual void evaluate() {}
+
+    /// Return the operation code of this expression node, with which a @ref Tape computes its partial derivatives without calling @ref partials.
+    virtual Opcode opcode() const { return Opcode::Generic; }
+
+    /// Return true if this expression node is a constant (see @ref ConstantExpr).
+    virtual bool isconstant() const { return false; }
+
+    /// Return true if this expression node has several outputs (see @ref MultiOutputExpr), which are swept with @ref pullback instead of @ref partials.
+    virtual bool multioutput() const { return false; }
+
+    /// Write the derivatives of the root expression node w.r.t. each of the child expression nodes of this expression node with several outputs.
+    /// @param tape The tape in which the derivatives of the root expression node w.r.t. the outputs of this expression node have been computed.
+    /// @param d The array of size @ref arity where the derivatives are written.
+    virtual void pullback(const Tape<T>& /* tape */, T* /* d */) const {}
+
+    /// Write the derivatives of the root expression nodes of all lanes of a vector-mode sweep w.r.t. each of the child expression nodes of this expression node with several outputs.
+    /// @param tape The tape in which the derivatives of the root expression nodes w.r.t. the outputs of this expression node have been computed (in @ref Tape::lanes lanes).
+    /// @param d The array of size @ref arity × lanes where the derivatives are written (the lanes of each child expression node stored contiguously).
+    virtual void pullbacks(const Tape<T>& /* tape */, T* /* d */) const {}
+
     /// Update the contribution of this expression in the derivative of the root node of the expression tree.
-    /// @param wprime The derivative of the root expression node w.r.t. the child expression of this expression node.
-    virtual void propagate(const T& wprime) = 0;
+    /// The expression nodes are visited only once each, in a single reverse sweep over their topological ordering (see @ref Tape).
+    /// @param wprime The derivative of the root expression node w.r.t. this expression node.
+    void propagate(const T& wprime)
+    {
+        Tape<T> tape(this);
+        tape.propagate(wprime);
+        for(auto i = 0U; i < tape.nodes.size(); ++i)
+            tape.nodes[i]->accumulate(tape.adjoints[i]);
+        tape.restore();
+    }
 
     /// Update the contribution of this expression in the derivative of the root node of the expression tree.
-    /// @param wprime The derivative of the root expression node w.r.t. the child expression of this expression node (as an expression).
-    virtual void propagatex(const ExprPtr<T>& wprime) = 0;
+    /// The expression nodes are visited only once each, in a single reverse sweep over their topological ordering (see @ref Tape).
+    /// @param wprime The derivative of the root expression node w.r.t. this expression node (as an expression).
+    void propagatex(const ExprPtr<T>& wprime)
+    {
+        Tape<T> tape(this);
+        tape.propagatex(wprime);
+        for(auto i = 0U; i < tape.nodes.size(); ++i)
+            if(tape.adjointsx[i])
+                tape.nodes[i]->accumulatex(tape.adjointsx[i]);
+        tape.restore();
+    }
 
-    /// Update the value of this expression
-    virtual void update() = 0;
+    /// Update the value of this expression (and of all expression nodes in its expression tree, in topological order).
+    void update()
+    {
+        Tape<T> tape(this);
+        tape.update();
+        tape.restore();
+    }
 };
 
+/// Release a child expression node of an expression node being destroyed, without recursion along the expression tree.
+/// When this is the last reference to the child expression node, it is moved
+/// to a list of pending nodes, which are destroyed one after the other in a
+/// loop by the outermost call, instead of recursively by their parents.
+template<typename Ptr>
+void dispose(Ptr& e)
+{
+    static thread_local std::vector<Ptr> pending;
+    static thread_local bool disposing = false;
+
+    if(!e || e.use_count() > 1) { e.reset(); return; }
+
+    pending.push_back(std::move(e));
+
+    if(disposing)
+        return;
+
+    disposing = true;
+    while(!pending.empty())
+    {
+        auto last = std::move(pending.back());
+        pending.pop_back();
+    } // last is destroyed here and pushes its own child expression nodes into pending
+    disposing = false;
+}
+
 /// The node in the expression tree representing either an independent or dependent variable.
 template<typename T>
 struct VariableExpr : Expr<T>
@@ -195,6 +710,16 @@ struct VariableExpr : Expr<T>
 
     virtual void bind_value(T* grad) { gradPtr = grad; }
     virtual void bind_expr(ExprPtr<T>* gradx) { gradxPtr = gradx; }
+
+    void accumulate(const T& wprime) override
+    {
+        if(gradPtr) { *gradPtr += wprime; }
+    }
+
+    void accumulatex(const ExprPtr<T>& wprime) override
+    {
+        if(gradxPtr) { *gradxPtr = *gradxPtr + wprime; }
+    }
 };
 
 /// The node in the expression tree representing an independent variable.
@@ -206,17 +731,6 @@ struct IndependentVariableExpr : VariableExpr<T>
 
     /// Construct an IndependentVariableExpr object with given value.
     IndependentVariableExpr(const T& v) : VariableExpr<T>(v) {}
-
-    void propagate(const T& wprime) override {
-        if(gradPtr) { *gradPtr += wprime; }
-    }
-
-    void propagatex(const ExprPtr<T>& wprime) override
-    {
-        if(gradxPtr) { *gradxPtr = *gradxPtr + wprime; }
-    }
-
-    void update() override {}
 };
 
 /// The node in the expression tree representing a dependent variable.
@@ -232,21 +746,26 @@ struct DependentVariableExpr : VariableExpr<T>
     /// Construct an DependentVariableExpr object with given value.
     DependentVariableExpr(const ExprPtr<T>& e) : VariableExpr<T>(e->val), expr(e) {}
 
-    void propagate(const T& wprime) override
+    ~DependentVariableExpr() { dispose(expr); }
+
+    std::size_t arity() const override { return 1; }
+
+    Expr<T>* operand(std::size_t /* i */) const override { return expr.get(); }
+
+    Opcode opcode() const override { return Opcode::Identity; }
+
+    void partials(T* d) const override
     {
-        if(gradPtr) { *gradPtr += wprime; }
-        expr->propagate(wprime);
+        d[0] = 1.0;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        if(gradxPtr) { *gradxPtr = *gradxPtr + wprime; }
-        expr->propagatex(wprime);
+        d[0] = nullptr;
     }
 
-    void update() override
+    void evaluate() override
     {
-        expr->update();
         this->val = expr->val;
     }
 };
@@ -256,16 +775,26 @@ struct ConstantExpr : Expr<T>
 {
     using Expr<T>::Expr;
 
-    void propagate([[maybe_unused]] const T& wprime) override
-    {}
-
-    void propagatex([[maybe_unused]] const ExprPtr<T>& wprime) override
-    {}
-
-    void update() override {}
+    bool isconstant() const override { return true; }
 };
 
-template<typename T> ExprPtr<T> constant(const T& val) { return std::make_shared<ConstantExpr<T>>(val); }
+template<typename T> ExprPtr<T> constant(const T& val) { return make_cached_expr<ConstantExpr<T>>(val); }
+
+/// Create an expression node of given type with given value and arguments (see @ref make_cached_expr), unless all its child expression nodes are constants.
+/// In that case, the value is returned in a constant expression node instead (constant folding).
+template<typename E, typename T, typename... Args>
+auto make_folded_expr(const T& val, const Args&... args) -> ExprPtr<T>
+{
+    auto folded = [](const auto& arg)
+    {
+        if constexpr(isSame<PlainType<decltype(arg)>, T>)
+            return true;
+        else return arg->isconstant();
+    };
+    if((folded(args) && ...))
+        return constant<T>(val);
+    return make_cached_expr<E>(val, args...);
+}
 
 template<typename T>
 struct UnaryExpr : Expr<T>
@@ -273,6 +802,12 @@ struct UnaryExpr : Expr<T>
     ExprPtr<T> x;
 
     UnaryExpr(const T& v, const ExprPtr<T>& e) : Expr<T>(v), x(e) {}
+
+    ~UnaryExpr() { dispose(x); }
+
+    std::size_t arity() const override { return 1; }
+
+    Expr<T>* operand(std::size_t /* i */) const override { return x.get(); }
 };
 
 template<typename T>
@@ -283,29 +818,128 @@ struct NegativeExpr : UnaryExpr<T>
 
     using UnaryExpr<T>::UnaryExpr;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Negative; }
+
+    void partials(T* d) const override
     {
-        x->propagate(-wprime);
+        d[0] = -1.0;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(-wprime);
+        d[0] = constant<T>(-1.0);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = -x->val;
     }
 };
 
+/// The node in the expression tree representing the product of an expression node and a constant stored in the node itself (e.g., `2.0 * x`).
+template<typename T>
+struct ScaleExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    /// The constant factor.
+    T c;
+
+    ScaleExpr(const T& v, const ExprPtr<T>& e, const T& cc) : UnaryExpr<T>(v, e), c(cc) {}
+
+    Opcode opcode() const override { return Opcode::Scale; }
+
+    void partials(T* d) const override
+    {
+        d[0] = c;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = constant<T>(c);
+    }
+
+    void evaluate() override
+    {
+        this->val = c * x->val;
+    }
+};
+
+/// The node in the expression tree representing the quotient of an expression node and a constant stored in the node itself (e.g., `x / 3.0`).
+/// The expression node is divided by the constant (instead of multiplied by its
+/// reciprocal, as in a @ref ScaleExpr node), so that its value is the IEEE quotient.
+template<typename T>
+struct QuotientExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    /// The constant divisor.
+    T c;
+
+    QuotientExpr(const T& v, const ExprPtr<T>& e, const T& cc) : UnaryExpr<T>(v, e), c(cc) {}
+
+    Opcode opcode() const override { return Opcode::Quotient; }
+
+    void partials(T* d) const override
+    {
+        d[0] = 1.0 / c;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = constant<T>(1.0 / c);
+    }
+
+    void evaluate() override
+    {
+        this->val = x->val / c;
+    }
+};
+
+/// The node in the expression tree representing the sum of an expression node and a constant stored in the node itself (e.g., `x + 1.0`).
+template<typename T>
+struct ShiftExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    /// The constant term.
+    T c;
+
+    ShiftExpr(const T& v, const ExprPtr<T>& e, const T& cc) : UnaryExpr<T>(v, e), c(cc) {}
+
+    Opcode opcode() const override { return Opcode::Shift; }
+
+    void partials(T* d) const override
+    {
+        d[0] = 1.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = nullptr;
+    }
+
+    void evaluate() override
+    {
+        this->val = x->val + c;
+    }
+};
+
 template<typename T>
 struct BinaryExpr : Expr<T>
 {
     ExprPtr<T> l, r;
 
     BinaryExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : Expr<T>(v), l(ll), r(rr) {}
+
+    ~BinaryExpr() { dispose(l); dispose(r); }
+
+    std::size_t arity() const override { return 2; }
+
+    Expr<T>* operand(std::size_t i) const override { return i == 0 ? l.get() : r.get(); }
 };
 
 template<typename T>
@@ -314,6 +948,12 @@ struct TernaryExpr : Expr<T>
     ExprPtr<T> l, c, r;
 
     TernaryExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& cc, const ExprPtr<T>& rr) : Expr<T>(v), l(ll), c(cc), r(rr) {}
+
+    ~TernaryExpr() { dispose(l); dispose(c); dispose(r); }
+
+    std::size_t arity() const override { return 3; }
+
+    Expr<T>* operand(std::size_t i) const override { return i == 0 ? l.get() : i == 1 ? c.get() : r.get(); }
 };
 
 template<typename T>
@@ -325,22 +965,22 @@ struct AddExpr : BinaryExpr<T>
 
     using BinaryExpr<T>::BinaryExpr;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Add; }
+
+    void partials(T* d) const override
     {
-        l->propagate(wprime);
-        r->propagate(wprime);
+        d[0] = 1.0;
+        d[1] = 1.0;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        l->propagatex(wprime);
-        r->propagatex(wprime);
+        d[0] = nullptr;
+        d[1] = nullptr;
     }
 
-    void update() override
+    void evaluate() override
     {
-        l->update();
-        r->update();
         this->val = l->val + r->val;
     }
 };
@@ -353,22 +993,22 @@ struct SubExpr : BinaryExpr<T>
     using BinaryExpr<T>::r;
     using BinaryExpr<T>::BinaryExpr;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Sub; }
+
+    void partials(T* d) const override
     {
-        l->propagate(wprime);
-        r->propagate(-wprime);
+        d[0] =  1.0;
+        d[1] = -1.0;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        l->propagatex(wprime);  // (l - r)'l =  l'
-        r->propagatex(-wprime); // (l - r)'r = -r'
+        d[0] = nullptr;            // (l - r)'l =  l'
+        d[1] = constant<T>(-1.0);  // (l - r)'r = -r'
     }
 
-    void update() override
+    void evaluate() override
     {
-        l->update();
-        r->update();
         this->val = l->val - r->val;
     }
 };
@@ -381,22 +1021,28 @@ struct MulExpr : BinaryExpr<T>
     using BinaryExpr<T>::r;
     using BinaryExpr<T>::BinaryExpr;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Mul; }
+
+    void partials(T* d) const override
+    {
+        d[0] = r->val; // (l * r)'l = r
+        d[1] = l->val; // (l * r)'r = l
+    }
+
+    void partials2(T* h) const override
     {
-        l->propagate(wprime * r->val); // (l * r)'l = w' * r
-        r->propagate(wprime * l->val); // (l * r)'r = l * w'
+        h[0] = 0.0; h[1] = 1.0;
+        h[2] = 1.0; h[3] = 0.0;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        l->propagatex(wprime * r);
-        r->propagatex(wprime * l);
+        d[0] = r;
+        d[1] = l;
     }
 
-    void update() override
+    void evaluate() override
     {
-        l->update();
-        r->update();
         this->val = l->val * r->val;
     }
 };
@@ -409,26 +1055,34 @@ struct DivExpr : BinaryExpr<T>
     using BinaryExpr<T>::r;
     using BinaryExpr<T>::BinaryExpr;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Div; }
+
+    void partials(T* d) const override
     {
         const auto aux1 = 1.0 / r->val;
         const auto aux2 = -l->val * aux1 * aux1;
-        l->propagate(wprime * aux1);
-        r->propagate(wprime * aux2);
+        d[0] = aux1;
+        d[1] = aux2;
+    }
+
+    void partials2(T* h) const override
+    {
+        const auto aux = 1.0 / r->val;
+        h[0] = 0.0;
+        h[1] = h[2] = -aux * aux;
+        h[3] = 2.0 * l->val * aux * aux * aux;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
         const auto aux1 = 1.0 / r;
         const auto aux2 = -l * aux1 * aux1;
-        l->propagatex(wprime * aux1);
-        r->propagatex(wprime * aux2);
+        d[0] = aux1;
+        d[1] = aux2;
     }
 
-    void update() override
+    void evaluate() override
     {
-        l->update();
-        r->update();
         this->val = l->val / r->val;
     }
 };
@@ -441,19 +1095,25 @@ struct SinExpr : UnaryExpr<T>
 
     SinExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Sin; }
+
+    void partials(T* d) const override
+    {
+        d[0] = cos(x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime * cos(x->val));
+        h[0] = -this->val;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime * cos(x));
+        d[0] = cos(x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = sin(x->val);
     }
 };
@@ -466,19 +1126,25 @@ struct CosExpr : UnaryExpr<T>
 
     CosExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Cos; }
+
+    void partials(T* d) const override
+    {
+        d[0] = -sin(x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(-wprime * sin(x->val));
+        h[0] = -this->val;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(-wprime * sin(x));
+        d[0] = -sin(x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = cos(x->val);
     }
 };
@@ -491,21 +1157,25 @@ struct TanExpr : UnaryExpr<T>
 
     TanExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
     {
         const auto aux = 1.0 / cos(x->val);
-        x->propagate(wprime * aux * aux);
+        d[0] = aux * aux;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partials2(T* h) const override
+    {
+        h[0] = 2.0 * this->val * (1.0 + this->val * this->val);
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
     {
         const auto aux = 1.0 / cos(x);
-        x->propagatex(wprime * aux * aux);
+        d[0] = aux * aux;
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = tan(x->val);
     }
 };
@@ -518,19 +1188,23 @@ struct SinhExpr : UnaryExpr<T>
 
     SinhExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
+    {
+        d[0] = cosh(x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime * cosh(x->val));
+        h[0] = this->val;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime * cosh(x));
+        d[0] = cosh(x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = sinh(x->val);
     }
 };
@@ -543,19 +1217,23 @@ struct CoshExpr : UnaryExpr<T>
 
     CoshExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
+    {
+        d[0] = sinh(x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime * sinh(x->val));
+        h[0] = this->val;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime * sinh(x));
+        d[0] = sinh(x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = cosh(x->val);
     }
 };
@@ -568,21 +1246,27 @@ struct TanhExpr : UnaryExpr<T>
 
     TanhExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Tanh; }
+
+    void partials(T* d) const override
     {
         const auto aux = 1.0 / cosh(x->val);
-        x->propagate(wprime * aux * aux);
+        d[0] = aux * aux;
+    }
+
+    void partials2(T* h) const override
+    {
+        h[0] = -2.0 * this->val * (1.0 - this->val * this->val);
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
         const auto aux = 1.0 / cosh(x);
-        x->propagatex(wprime * aux * aux);
+        d[0] = aux * aux;
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = tanh(x->val);
     }
 };
@@ -595,19 +1279,24 @@ struct ArcSinExpr : UnaryExpr<T>
 
     ArcSinExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
+    {
+        d[0] = 1.0 / sqrt(1.0 - x->val * x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime / sqrt(1.0 - x->val * x->val));
+        const auto aux = 1.0 - x->val * x->val;
+        h[0] = x->val / (aux * sqrt(aux));
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime / sqrt(1.0 - x * x));
+        d[0] = 1.0 / sqrt(1.0 - x * x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = asin(x->val);
     }
 };
@@ -620,19 +1309,24 @@ struct ArcCosExpr : UnaryExpr<T>
 
     ArcCosExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
     {
-        x->propagate(-wprime / sqrt(1.0 - x->val * x->val));
+        d[0] = -1.0 / sqrt(1.0 - x->val * x->val);
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partials2(T* h) const override
     {
-        x->propagatex(-wprime / sqrt(1.0 - x * x));
+        const auto aux = 1.0 - x->val * x->val;
+        h[0] = -x->val / (aux * sqrt(aux));
     }
 
-    void update() override
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = -1.0 / sqrt(1.0 - x * x);
+    }
+
+    void evaluate() override
     {
-        x->update();
         this->val = acos(x->val);
     }
 };
@@ -645,19 +1339,24 @@ struct ArcTanExpr : UnaryExpr<T>
 
     ArcTanExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
+    {
+        d[0] = 1.0 / (1.0 + x->val * x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime / (1.0 + x->val * x->val));
+        const auto aux = 1.0 / (1.0 + x->val * x->val);
+        h[0] = -2.0 * x->val * aux * aux;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime / (1.0 + x * x));
+        d[0] = 1.0 / (1.0 + x * x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = atan(x->val);
     }
 };
@@ -671,24 +1370,30 @@ struct ArcTan2Expr : BinaryExpr<T>
 
     ArcTan2Expr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
+    {
+        const auto aux = 1.0 / (l->val * l->val + r->val * r->val);
+        d[0] = r->val * aux;
+        d[1] = -l->val * aux;
+    }
+
+    void partials2(T* h) const override
     {
-        const auto aux = wprime / (l->val * l->val + r->val * r->val);
-        l->propagate(r->val * aux);
-        r->propagate(-l->val * aux);
+        const auto aux = 1.0 / (l->val * l->val + r->val * r->val);
+        h[0] = -2.0 * l->val * r->val * aux * aux;
+        h[1] = h[2] = (l->val * l->val - r->val * r->val) * aux * aux;
+        h[3] = 2.0 * l->val * r->val * aux * aux;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        const auto aux = wprime / (l * l + r * r);
-        l->propagatex(r * aux);
-        r->propagatex(-l * aux);
+        const auto aux = 1.0 / (l * l + r * r);
+        d[0] = r * aux;
+        d[1] = -l * aux;
     }
 
-    void update() override
+    void evaluate() override
     {
-        l->update();
-        r->update();
         this->val = atan2(l->val, r->val);
     }
 };
@@ -701,19 +1406,25 @@ struct ExpExpr : UnaryExpr<T>
     using UnaryExpr<T>::val;
     using UnaryExpr<T>::x;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Exp; }
+
+    void partials(T* d) const override
+    {
+        d[0] = val; // exp(x)' = exp(x) * x'
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime * val); // exp(x)' = exp(x) * x'
+        h[0] = val;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime * exp(x));
+        d[0] = exp(x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = exp(x->val);
     }
 };
@@ -725,19 +1436,25 @@ struct LogExpr : UnaryExpr<T>
     using UnaryExpr<T>::x;
     using UnaryExpr<T>::UnaryExpr;
 
-    void propagate(const T& wprime) override
+    Opcode opcode() const override { return Opcode::Log; }
+
+    void partials(T* d) const override
+    {
+        d[0] = 1.0 / x->val; // log(x)' = x'/x
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime / x->val); // log(x)' = x'/x
+        h[0] = -1.0 / (x->val * x->val);
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime / x);
+        d[0] = 1.0 / x;
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = log(x->val);
     }
 };
@@ -752,19 +1469,23 @@ struct Log10Expr : UnaryExpr<T>
 
     Log10Expr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
+    {
+        d[0] = 1.0 / (ln10 * x->val);
+    }
+
+    void partials2(T* h) const override
     {
-        x->propagate(wprime / (ln10 * x->val));
+        h[0] = -1.0 / (ln10 * x->val * x->val);
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* d) const override
     {
-        x->propagatex(wprime / (ln10 * x));
+        d[0] = 1.0 / (ln10 * x);
     }
 
-    void update() override
+    void evaluate() override
     {
-        x->update();
         this->val = log10(x->val);
     }
 };
@@ -781,407 +1502,2201 @@ struct PowExpr : BinaryExpr<T>
 
     PowExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr), log_l(log(ll->val)) {}
 
-    void propagate(const T& wprime) override
+    void partials(T* d) const override
     {
         using U = VariableValueType<T>;
         constexpr auto zero = U(0.0);
         const auto lval = l->val;
         const auto rval = r->val;
-        const auto aux = wprime * pow(lval, rval - 1);
-        l->propagate(aux * rval);
+        const auto aux = pow(lval, rval - 1);
+        d[0] = aux * rval;
         const auto auxr = lval == zero ? 0.0 : lval * log(lval); // since x*log(x) -> 0 as x -> 0
-        r->propagate(aux * auxr);
+        d[1] = aux * auxr;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partials2(T* h) const override
     {
         using U = VariableValueType<T>;
         constexpr auto zero = U(0.0);
-        const auto aux = wprime * pow(l, r - 1);
-        l->propagatex(aux * r);
-        const auto auxr = l == zero ? 0.0*l : l * log(l); // since x*log(x) -> 0 as x -> 0
-        r->propagatex(aux * auxr);
+        const auto lval = l->val;
+        const auto rval = r->val;
+        const auto aux = pow(lval, rval - 1);
+        const auto logl = lval == zero ? 0.0 : log(lval); // the terms with log(l) vanish as l -> 0
+        h[0] = rval * (rval - 1) * pow(lval, rval - 2);
+        h[1] = h[2] = aux * (1.0 + rval * logl);
+        h[3] = val * logl * logl;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        using U = VariableValueType<T>;
+        constexpr auto zero = U(0.0);
+        const auto aux = pow(l, r - 1);
+        d[0] = aux * r;
+        const auto auxr = l->val == zero ? 0.0*l : l * log(l); // since x*log(x) -> 0 as x -> 0
+        d[1] = aux * auxr;
+    }
+
+    void evaluate() override
+    {
+        this->val = pow(l->val, r->val);
+    }
+};
+
+template<typename T>
+struct PowConstantLeftExpr : BinaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using BinaryExpr<T>::val;
+    using BinaryExpr<T>::l;
+    using BinaryExpr<T>::r;
+
+    PowConstantLeftExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+
+    // The constant base l is not a child expression node for differentiation purposes
+    std::size_t arity() const override { return 1; }
+
+    Expr<T>* operand(std::size_t /* i */) const override { return r.get(); }
+
+    void partials(T* d) const override
+    {
+        const auto lval = l->val;
+        const auto rval = r->val;
+        const auto aux = pow(lval, rval - 1);
+        const auto auxr = lval == 0.0 ? 0.0 : lval * log(lval); // since x*log(x) -> 0 as x -> 0
+        d[0] = aux * auxr;
+    }
+
+    void partials2(T* h) const override
+    {
+        const auto logl = l->val == 0.0 ? 0.0 : log(l->val);
+        h[0] = this->val * logl * logl;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        const auto aux = pow(l, r - 1);
+        const auto auxr = l->val == 0.0 ? 0.0*l : l * log(l); // since x*log(x) -> 0 as x -> 0
+        d[0] = aux * auxr;
+    }
+
+    void evaluate() override
+    {
+        this->val = pow(l->val, r->val);
+    }
+};
+
+template<typename T>
+struct PowConstantRightExpr : BinaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using BinaryExpr<T>::val;
+    using BinaryExpr<T>::l;
+    using BinaryExpr<T>::r;
+
+    PowConstantRightExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+
+    // The constant exponent r is not a child expression node for differentiation purposes
+    std::size_t arity() const override { return 1; }
+
+    Expr<T>* operand(std::size_t /* i */) const override { return l.get(); }
+
+    void partials(T* d) const override
+    {
+        d[0] = pow(l->val, r->val - 1) * r->val; // pow(l, r)'l = r * pow(l, r - 1) * l'
     }
 
-    void update() override
+    void partials2(T* h) const override
+    {
+        h[0] = r->val * (r->val - 1) * pow(l->val, r->val - 2);
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = pow(l, r - 1) * r;
+    }
+
+    void evaluate() override
     {
-        l->update();
-        r->update();
         this->val = pow(l->val, r->val);
     }
 };
 
 template<typename T>
-struct PowConstantLeftExpr : BinaryExpr<T>
+struct SqrtExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    SqrtExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+
+    Opcode opcode() const override { return Opcode::Sqrt; }
+
+    void partials(T* d) const override
+    {
+        d[0] = 1.0 / (2.0 * sqrt(x->val)); // sqrt(x)' = 1/2 * 1/sqrt(x) * x'
+    }
+
+    void partials2(T* h) const override
+    {
+        h[0] = -0.25 / (x->val * this->val);
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = 1.0 / (2.0 * sqrt(x));
+    }
+
+    void evaluate() override
+    {
+        this->val = sqrt(x->val);
+    }
+};
+
+template<typename T>
+struct AbsExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+    using U = VariableValueType<T>;
+
+    AbsExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+
+    void partials(T* d) const override
+    {
+        if(x->val < 0.0) d[0] = -1.0;
+        else if(x->val > 0.0) d[0] = 1.0;
+        else d[0] = 0.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        if(x->val < 0.0) d[0] = constant<T>(-1.0);
+        else if(x->val > 0.0) d[0] = nullptr;
+        else d[0] = constant<T>(0.0);
+    }
+
+    void evaluate() override
+    {
+        this->val = abs(x->val);
+    }
+};
+
+template<typename T>
+struct ErfExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    constexpr static auto sqrt_pi = static_cast<VariableValueType<T>>(1.7724538509055160272981674833411451872554456638435);
+
+    ErfExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+
+    void partials(T* d) const override
+    {
+        d[0] = 2.0 / sqrt_pi * exp(-(x->val) * (x->val)); // erf(x)' = 2/sqrt(pi) * exp(-x * x) * x'
+    }
+
+    void partials2(T* h) const override
+    {
+        h[0] = -4.0 / sqrt_pi * x->val * exp(-(x->val) * (x->val));
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = 2.0 / sqrt_pi * exp(-x * x);
+    }
+
+    void evaluate() override
+    {
+        this->val = erf(x->val);
+    }
+};
+
+template<typename T>
+struct Hypot2Expr : BinaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using BinaryExpr<T>::val;
+    using BinaryExpr<T>::l;
+    using BinaryExpr<T>::r;
+
+    Hypot2Expr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+
+    void partials(T* d) const override
+    {
+        d[0] = l->val / val; // sqrt(l*l + r*r)'l = 1/2 * 1/sqrt(l*l + r*r) * (2*l*l') = (l*l')/sqrt(l*l + r*r)
+        d[1] = r->val / val; // sqrt(l*l + r*r)'r = 1/2 * 1/sqrt(l*l + r*r) * (2*r*r') = (r*r')/sqrt(l*l + r*r)
+    }
+
+    void partials2(T* h) const override
+    {
+        const auto aux = 1.0 / (val * val * val);
+        h[0] = r->val * r->val * aux;
+        h[1] = h[2] = -l->val * r->val * aux;
+        h[3] = l->val * l->val * aux;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = l / hypot(l, r);
+        d[1] = r / hypot(l, r);
+    }
+
+    void evaluate() override
+    {
+        this->val = hypot(l->val, r->val);
+    }
+};
+
+template<typename T>
+struct Hypot3Expr : TernaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using TernaryExpr<T>::val;
+    using TernaryExpr<T>::l;
+    using TernaryExpr<T>::c;
+    using TernaryExpr<T>::r;
+
+    Hypot3Expr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& cc, const ExprPtr<T>& rr) : TernaryExpr<T>(v, ll, cc, rr) {}
+
+    void partials(T* d) const override
+    {
+        d[0] = l->val / val;
+        d[1] = c->val / val;
+        d[2] = r->val / val;
+    }
+
+    void partials2(T* h) const override
+    {
+        const auto aux = 1.0 / (val * val * val);
+        const T z[3] = { l->val, c->val, r->val };
+        for(auto i = 0; i < 3; ++i)
+            for(auto j = 0; j < 3; ++j)
+                h[3 * i + j] = ((i == j ? val * val : T(0.0)) - z[i] * z[j]) * aux;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = l / hypot(l, c, r);
+        d[1] = c / hypot(l, c, r);
+        d[2] = r / hypot(l, c, r);
+    }
+
+    void evaluate() override
+    {
+        this->val = hypot(l->val, c->val, r->val);
+    }
+};
+
+/// The node in the expression tree representing the sum of any number of expression nodes (e.g., in reductions such as `x.sum()`).
+/// The terms are stored contiguously in a single expression node, instead of in a
+/// chain of @ref AddExpr nodes, so that the derivatives w.r.t. all of them are
+/// computed in a single loop, without deep recursion along the expression tree.
+template<typename T>
+struct SumExpr : Expr<T>
+{
+    /// The child expression nodes of this expression node (the terms of the sum).
+    std::vector<ExprPtr<T>> terms;
+
+    /// Construct a SumExpr object with given terms.
+    explicit SumExpr(std::vector<ExprPtr<T>> t) : Expr<T>(0.0), terms(std::move(t)) { evaluate(); }
+
+    ~SumExpr() { for(auto& e : terms) dispose(e); }
+
+    /// Append a term to this sum (only if this expression node is not shared with other expression trees).
+    void append(const ExprPtr<T>& e)
+    {
+        terms.push_back(e);
+        this->val += e->val;
+    }
+
+    std::size_t arity() const override { return terms.size(); }
+
+    Expr<T>* operand(std::size_t i) const override { return terms[i].get(); }
+
+    Opcode opcode() const override { return Opcode::Sum; }
+
+    void partials(T* d) const override
+    {
+        std::fill(d, d + terms.size(), T(1.0));
+    }
+
+    void nonzeros2(std::vector<T>& /* h */, std::vector<std::tuple<std::size_t, std::size_t, T>>& /* entries */) const override {}
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        std::fill(d, d + terms.size(), nullptr);
+    }
+
+    void evaluate() override
+    {
+        T sum = 0.0;
+        for(const auto& e : terms)
+            sum += e->val;
+        this->val = sum;
+    }
+};
+
+/// The node in the expression tree representing the sum of the products of two lists of expression nodes of the same size (e.g., in `x.dot(y)`).
+/// The child expression nodes are the factors l[0], ..., l[n-1], r[0], ..., r[n-1], stored contiguously.
+template<typename T>
+struct DotExpr : Expr<T>
+{
+    /// The child expression nodes of this expression node (the left factors followed by the right factors).
+    std::vector<ExprPtr<T>> factors;
+
+    /// Construct a DotExpr object with given left factors followed by the right ones.
+    explicit DotExpr(std::vector<ExprPtr<T>> f) : Expr<T>(0.0), factors(std::move(f)) { assert(factors.size() % 2 == 0); evaluate(); }
+
+    ~DotExpr() { for(auto& e : factors) dispose(e); }
+
+    std::size_t arity() const override { return factors.size(); }
+
+    Expr<T>* operand(std::size_t i) const override { return factors[i].get(); }
+
+    void partials(T* d) const override
+    {
+        const auto n = factors.size() / 2;
+        for(auto k = 0U; k < n; ++k)
+        {
+            d[k] = factors[n + k]->val;
+            d[n + k] = factors[k]->val;
+        }
+    }
+
+    void partials2(T* h) const override
+    {
+        const auto m = factors.size();
+        const auto n = m / 2;
+        std::fill(h, h + m * m, T(0.0));
+        for(auto k = 0U; k < n; ++k)
+            h[k * m + n + k] = h[(n + k) * m + k] = 1.0;
+    }
+
+    void nonzeros2(std::vector<T>& /* h */, std::vector<std::tuple<std::size_t, std::size_t, T>>& entries) const override
+    {
+        const auto n = factors.size() / 2;
+        for(auto k = 0U; k < n; ++k)
+            entries.emplace_back(k, n + k, T(1.0));
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        const auto n = factors.size() / 2;
+        for(auto k = 0U; k < n; ++k)
+        {
+            d[k] = factors[n + k];
+            d[n + k] = factors[k];
+        }
+    }
+
+    void evaluate() override
+    {
+        const auto n = factors.size() / 2;
+        T sum = 0.0;
+        for(auto k = 0U; k < n; ++k)
+            sum += factors[k]->val * factors[n + k]->val;
+        this->val = sum;
+    }
+};
+
+/// The node in the expression tree representing a statement whose expression tree has been collapsed into the derivatives w.r.t. its inputs (see @ref Preaccumulation).
+/// The child expression nodes are the variables the statement depends on, and the
+/// partial derivatives w.r.t. them are those computed when the statement was assigned.
+/// Its value and derivatives cannot be recomputed for new values of its inputs, so
+/// that updating it after any of them has changed throws a std::logic_error.
+template<typename T>
+struct PreaccumulatedExpr : Expr<T>
+{
+    /// The child expression nodes of this expression node (the inputs of the statement).
+    std::vector<ExprPtr<T>> inputs;
+
+    /// The derivatives of the statement w.r.t. each of its inputs.
+    std::vector<T> weights;
+
+    /// The values of the inputs of the statement when it was assigned.
+    std::vector<T> values;
+
+    /// Construct a PreaccumulatedExpr object with given value, inputs and derivatives w.r.t. them.
+    PreaccumulatedExpr(const T& v, std::vector<ExprPtr<T>> x, std::vector<T> w) : Expr<T>(v), inputs(std::move(x)), weights(std::move(w))
+    {
+        assert(inputs.size() == weights.size());
+        values.reserve(inputs.size());
+        for(const auto& e : inputs)
+            values.push_back(e->val);
+    }
+
+    ~PreaccumulatedExpr() { for(auto& e : inputs) dispose(e); }
+
+    std::size_t arity() const override { return inputs.size(); }
+
+    Expr<T>* operand(std::size_t i) const override { return inputs[i].get(); }
+
+    void partials(T* d) const override
+    {
+        std::copy(weights.begin(), weights.end(), d);
+    }
+
+    void nonzeros2(std::vector<T>& /* h */, std::vector<std::tuple<std::size_t, std::size_t, T>>& /* entries */) const override
+    {
+        throw std::logic_error("Second-order derivatives of preaccumulated statements are not supported.");
+    }
+
+    void partialsx(ExprPtr<T>* /* d */) const override
+    {
+        throw std::logic_error("Derivative expressions of preaccumulated statements are not supported.");
+    }
+
+    void evaluate() override
+    {
+        for(auto i = 0U; i < inputs.size(); ++i)
+            if(inputs[i]->val != values[i])
+                throw std::logic_error("Preaccumulated statements cannot be updated for new values of their inputs.");
+    }
+};
+
+// Any expression yielding a boolean depending on arithmetic subexpressions
+struct BooleanExpr
+{
+    std::function<bool()> expr;
+    bool val = {};
+
+    explicit BooleanExpr(std::function<bool()> expression) : expr(std::move(expression)) { update(); }
+
+    /// Return the value of this boolean expression (recording it as a branch taken if a tape is being recorded, see @ref ReplayTape).
+    operator bool() const
+    {
+        if(auto* branches = recorded())
+            branches->push_back(*this);
+        return val;
+    }
+
+    void update() { val = expr(); }
+
+    /// Return the list where the boolean expressions that decide branches are recorded in the current thread (nullptr if not recording).
+    static std::vector<BooleanExpr>*& recorded()
+    {
+        static thread_local std::vector<BooleanExpr>* branches = nullptr;
+        return branches;
+    }
+
+    auto operator! () const { return BooleanExpr([=]() { return !(expr()); }); }
+};
+
+template<typename Op> auto bool_expr_op(BooleanExpr& l, BooleanExpr& r, Op op) {
+    return BooleanExpr([=]() mutable -> bool {
+        l.update();
+        r.update();
+        return op(l.val, r.val);
+    });
+}
+
+inline auto operator && (BooleanExpr&& l, BooleanExpr&& r) { return bool_expr_op(l, r, std::logical_and<> {}); }
+inline auto operator || (BooleanExpr&& l, BooleanExpr&& r) { return bool_expr_op(l, r, std::logical_or<> {}); }
+
+/// Select between expression branches depending on a boolean expression
+template<typename T>
+struct ConditionalExpr : Expr<T>
+{
+    // Using declarations for data members of base class
+    BooleanExpr predicate;
+    using Expr<T>::val;
+    ExprPtr<T> l, r;
+
+    ConditionalExpr(const BooleanExpr& wrappedPred, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : Expr<T>(wrappedPred.val ? ll->val : rr->val), predicate(wrappedPred), l(ll), r(rr) {}
+
+    ~ConditionalExpr() { dispose(l); dispose(r); }
+
+    std::size_t arity() const override { return 2; }
+
+    Expr<T>* operand(std::size_t i) const override { return i == 0 ? l.get() : r.get(); }
+
+    void partials(T* d) const override
+    {
+        d[0] = predicate.val ? 1.0 : 0.0;
+        d[1] = predicate.val ? 0.0 : 1.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = derive(constant<T>(1.0), constant<T>(0.0));
+        d[1] = derive(constant<T>(0.0), constant<T>(1.0));
+    }
+
+    void evaluate() override
+    {
+        predicate.update();
+        this->val = predicate.val ? l->val : r->val;
+    }
+
+    ExprPtr<T> derive(const ExprPtr<T>& left, const ExprPtr<T>& right) const {
+      return make_expr<ConditionalExpr>(predicate, left, right);
+    }
+};
+
+/// The comparison operators of the predicates of @ref SelectExpr nodes.
+enum class Comparison : std::uint8_t
+{
+    Less, Greater, LessEqual, GreaterEqual, Equal, NotEqual
+};
+
+/// Return the result of a comparison between two values.
+template<typename T>
+bool compare(Comparison op, const T& a, const T& b)
+{
+    switch(op)
+    {
+        case Comparison::Less: return a < b;
+        case Comparison::Greater: return a > b;
+        case Comparison::LessEqual: return a <= b;
+        case Comparison::GreaterEqual: return a >= b;
+        case Comparison::Equal: return a == b;
+        default: return a != b;
+    }
+}
+
+/// Return the comparison that holds whenever a given comparison does not (for values that are not NaN).
+inline Comparison complement(Comparison op)
+{
+    switch(op)
+    {
+        case Comparison::Less: return Comparison::GreaterEqual;
+        case Comparison::Greater: return Comparison::LessEqual;
+        case Comparison::LessEqual: return Comparison::Greater;
+        case Comparison::GreaterEqual: return Comparison::Less;
+        case Comparison::Equal: return Comparison::NotEqual;
+        default: return Comparison::Equal;
+    }
+}
+
+/// The comparison between two expression trees (e.g., `x < y`), stored as a comparison operator and handles to them.
+/// It is turned by @ref condition into a @ref SelectExpr node, without any closure,
+/// and converted into a @ref BooleanExpr when combined with other boolean expressions
+/// (e.g., in `0 <= x && x <= 1`).
+template<typename T>
+struct ComparisonExpr
+{
+    /// The comparison operator.
+    Comparison op;
+
+    /// The compared expression trees.
+    ExprPtr<T> l, r;
+
+    /// The result of the comparison for the values of the compared expression trees when it was created.
+    bool val = {};
+
+    /// Construct a ComparisonExpr object with given comparison operator and compared expression trees.
+    ComparisonExpr(Comparison o, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : op(o), l(ll), r(rr), val(compare(o, ll->val, rr->val)) {}
+
+    /// Return the value of this comparison (recording it as a branch taken if a tape is being recorded, see @ref ReplayTape).
+    operator bool() const
+    {
+        if(auto* comparisons = recorded())
+            comparisons->push_back(*this);
+        else if(auto* branches = BooleanExpr::recorded())
+            branches->push_back(BooleanExpr(*this));
+        return val;
+    }
+
+    /// Return the list where the comparisons that decide branches are recorded in the current thread (nullptr if not recording).
+    static std::vector<ComparisonExpr>*& recorded()
+    {
+        static thread_local std::vector<ComparisonExpr>* comparisons = nullptr;
+        return comparisons;
+    }
+
+    /// Convert this comparison into a boolean expression that updates the compared expression trees when it is updated.
+    operator BooleanExpr() const
+    {
+        return BooleanExpr([op = op, l = l, r = r]() mutable -> bool {
+            l->update();
+            r->update();
+            return compare(op, l->val, r->val);
+        });
+    }
+
+    /// Return the negation of this comparison.
+    auto operator!() const { return ComparisonExpr(complement(op), l, r); }
+};
+
+template<typename T> struct isComparisonExprTrait { constexpr static bool value = false; };
+template<typename T> struct isComparisonExprTrait<ComparisonExpr<T>> { constexpr static bool value = true; };
+
+/// A compile-time constant that indicates whether a type is a comparison between expression trees.
+template<typename T>
+constexpr bool isComparisonExpr = isComparisonExprTrait<PlainType<T>>::value;
+
+/// A compile-time constant that indicates whether the arguments of a logical operation involve a comparison between expression trees (and are otherwise boolean expressions).
+template<typename L, typename R>
+constexpr bool isComparisonOperands = (isComparisonExpr<L> || isComparisonExpr<R>) && (isComparisonExpr<L> || isSame<PlainType<L>, BooleanExpr>) && (isComparisonExpr<R> || isSame<PlainType<R>, BooleanExpr>);
+
+template<typename L, typename R, Requires<isComparisonOperands<L, R>> = true> auto operator && (const L& l, const R& r) { return BooleanExpr(l) && BooleanExpr(r); }
+template<typename L, typename R, Requires<isComparisonOperands<L, R>> = true> auto operator || (const L& l, const R& r) { return BooleanExpr(l) || BooleanExpr(r); }
+
+/// The node in the expression tree representing the selection between two expression nodes depending on a comparison between two others (e.g., `condition(x < y, a, b)`).
+/// The child expression nodes are the two compared expression nodes followed by the
+/// two branches. The comparison is evaluated from the values of the compared expression
+/// nodes, which precede this node in a tape, without a closure or any subtree update.
+template<typename T>
+struct SelectExpr : Expr<T>
+{
+    /// The comparison operator.
+    Comparison op;
+
+    /// The compared expression nodes.
+    ExprPtr<T> a, b;
+
+    /// The expression nodes selected when the comparison holds (l) or not (r).
+    ExprPtr<T> l, r;
+
+    /// The result of the comparison when this expression node was last evaluated.
+    bool selected;
+
+    SelectExpr(Comparison o, const ExprPtr<T>& aa, const ExprPtr<T>& bb, const ExprPtr<T>& ll, const ExprPtr<T>& rr)
+    : Expr<T>(compare(o, aa->val, bb->val) ? ll->val : rr->val), op(o), a(aa), b(bb), l(ll), r(rr), selected(compare(o, aa->val, bb->val)) {}
+
+    ~SelectExpr() { dispose(a); dispose(b); dispose(l); dispose(r); }
+
+    std::size_t arity() const override { return 4; }
+
+    Expr<T>* operand(std::size_t i) const override
+    {
+        switch(i)
+        {
+            case 0: return a.get();
+            case 1: return b.get();
+            case 2: return l.get();
+            default: return r.get();
+        }
+    }
+
+    void partials(T* d) const override
+    {
+        d[0] = 0.0;
+        d[1] = 0.0;
+        d[2] = selected ? 1.0 : 0.0;
+        d[3] = selected ? 0.0 : 1.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = constant<T>(0.0);
+        d[1] = constant<T>(0.0);
+        d[2] = select(op, a, b, constant<T>(1.0), constant<T>(0.0));
+        d[3] = select(op, a, b, constant<T>(0.0), constant<T>(1.0));
+    }
+
+    void evaluate() override
+    {
+        selected = compare(op, a->val, b->val);
+        this->val = selected ? l->val : r->val;
+    }
+};
+
+/// Return the expression node selecting between two expression nodes depending on a comparison between two others (see @ref SelectExpr).
+template<typename T>
+auto select(Comparison op, const ExprPtr<T>& a, const ExprPtr<T>& b, const ExprPtr<T>& l, const ExprPtr<T>& r) -> ExprPtr<T>
+{
+    if(a->isconstant() && b->isconstant())
+        return compare(op, a->val, b->val) ? l : r;
+    return make_expr<SelectExpr<T>>(op, a, b, l, r);
+}
+
+/// The node in the expression tree representing the minimum of two expression nodes (the right one if they are equal).
+template<typename T>
+struct MinExpr : BinaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using BinaryExpr<T>::l;
+    using BinaryExpr<T>::r;
+
+    MinExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+
+    Opcode opcode() const override { return Opcode::Min; }
+
+    void partials(T* d) const override
+    {
+        d[0] = l->val < r->val ? 1.0 : 0.0;
+        d[1] = l->val < r->val ? 0.0 : 1.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = select(Comparison::Less, l, r, constant<T>(1.0), constant<T>(0.0));
+        d[1] = select(Comparison::Less, l, r, constant<T>(0.0), constant<T>(1.0));
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val < r->val ? l->val : r->val;
+    }
+};
+
+/// The node in the expression tree representing the maximum of two expression nodes (the right one if they are equal).
+template<typename T>
+struct MaxExpr : BinaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using BinaryExpr<T>::l;
+    using BinaryExpr<T>::r;
+
+    MaxExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+
+    Opcode opcode() const override { return Opcode::Max; }
+
+    void partials(T* d) const override
+    {
+        d[0] = l->val > r->val ? 1.0 : 0.0;
+        d[1] = l->val > r->val ? 0.0 : 1.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = select(Comparison::Greater, l, r, constant<T>(1.0), constant<T>(0.0));
+        d[1] = select(Comparison::Greater, l, r, constant<T>(0.0), constant<T>(1.0));
+    }
+
+    void evaluate() override
+    {
+        this->val = l->val > r->val ? l->val : r->val;
+    }
+};
+
+/// The node in the expression tree representing the sign of an expression node (-1, 0 or 1), whose derivative is zero.
+template<typename T>
+struct SgnExpr : UnaryExpr<T>
+{
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    SgnExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+
+    void partials(T* d) const override
+    {
+        d[0] = 0.0;
+    }
+
+    void partialsx(ExprPtr<T>* d) const override
+    {
+        d[0] = constant<T>(0.0);
+    }
+
+    void evaluate() override
+    {
+        this->val = sign(x->val);
+    }
+
+    /// Return the sign of a value (-1, 0 or 1).
+    static T sign(const T& v)
+    {
+        return v < 0.0 ? T(-1.0) : v > 0.0 ? T(1.0) : T(0.0);
+    }
+};
+
+/// The node in the expression tree representing an expression with several outputs (e.g., a checkpointed region of a computation).
+/// Each output is an @ref OutputExpr node with this expression node as its only
+/// child. In a reverse sweep, all output nodes are visited before this node,
+/// whose derivatives w.r.t. its inputs are then computed at once from the
+/// derivatives w.r.t. its outputs, with a vector-Jacobian product (see @ref vjp).
+template<typename T>
+struct MultiOutputExpr : Expr<T>
+{
+    /// The child expression nodes of this expression node (its inputs).
+    std::vector<ExprPtr<T>> inputs;
+
+    /// The values of the outputs of this expression node.
+    std::vector<T> values;
+
+    /// The output expression nodes of this expression node (null if already destroyed).
+    std::vector<Expr<T>*> outputs;
+
+    /// Construct a MultiOutputExpr object with given inputs and number of outputs.
+    MultiOutputExpr(std::vector<ExprPtr<T>> in, std::size_t m) : Expr<T>(0.0), inputs(std::move(in)), values(m), outputs(m, nullptr) {}
+
+    ~MultiOutputExpr() { for(auto& e : inputs) dispose(e); }
+
+    std::size_t arity() const override { return inputs.size(); }
+
+    Expr<T>* operand(std::size_t i) const override { return inputs[i].get(); }
+
+    bool multioutput() const override { return true; }
+
+    void pullback(const Tape<T>& tape, T* d) const override
+    {
+        std::vector<T> w(outputs.size());
+        for(auto j = 0U; j < outputs.size(); ++j)
+            w[j] = outputs[j] ? tape.adjoint(outputs[j]) : T(0.0);
+        vjp(w.data(), d);
+    }
+
+    void pullbacks(const Tape<T>& tape, T* d) const override
+    {
+        const auto m = outputs.size();
+        const auto n = inputs.size();
+        const auto lanes = tape.lanes;
+
+        // The derivatives w.r.t. the outputs of the lanes in which they are not all zero, lane by lane
+        std::vector<std::size_t> active;
+        std::vector<T> w;
+        w.reserve(m * lanes);
+        for(auto l = 0U; l < lanes; ++l)
+        {
+            const auto offset = w.size();
+            for(auto j = 0U; j < m; ++j)
+                w.push_back(outputs[j] ? tape.adjoint(outputs[j], l) : T(0.0));
+            bool zero = false;
+            if constexpr(isArithmetic<T>)
+                zero = std::all_of(w.begin() + offset, w.end(), [](const T& wj) { return wj == 0.0; });
+            if(zero)
+                w.resize(offset);
+            else active.push_back(l);
+        }
+
+        std::fill(d, d + n * lanes, T(0.0));
+        if(active.empty())
+            return;
+
+        std::vector<T> dl(n * active.size());
+        vjps(w.data(), dl.data(), active.size());
+        for(auto a = 0U; a < active.size(); ++a)
+            for(auto k = 0U; k < n; ++k)
+                d[k * lanes + active[a]] = dl[a * n + k];
+    }
+
+    /// Write the derivatives of the root expression node w.r.t. the inputs given its derivatives w.r.t. the outputs.
+    /// @param w The array with the derivatives of the root expression node w.r.t. the outputs.
+    /// @param d The array where the derivatives of the root expression node w.r.t. the inputs are written.
+    virtual void vjp(const T* w, T* d) const = 0;
+
+    /// Write the derivatives of several root expression nodes w.r.t. the inputs given their derivatives w.r.t. the outputs (one @ref vjp per root expression node, unless overridden).
+    /// @param w The array with the derivatives of each root expression node w.r.t. the outputs, stored root by root.
+    /// @param d The array where the derivatives of each root expression node w.r.t. the inputs are written, stored root by root.
+    /// @param count The number of root expression nodes.
+    virtual void vjps(const T* w, T* d, std::size_t count) const
+    {
+        for(auto l = 0U; l < count; ++l)
+            vjp(w + l * outputs.size(), d + l * inputs.size());
+    }
+};
+
+/// The node in the expression tree representing one of the outputs of a @ref MultiOutputExpr node.
+template<typename T>
+struct OutputExpr : Expr<T>
+{
+    /// The expression node with several outputs (of type MultiOutputExpr).
+    ExprPtr<T> hub;
+
+    /// The position of this output in the outputs of the hub expression node.
+    std::size_t j;
+
+    /// Construct an OutputExpr object representing the output of given index in a MultiOutputExpr node.
+    OutputExpr(const ExprPtr<T>& h, std::size_t jj) : Expr<T>(static_cast<MultiOutputExpr<T>*>(h.get())->values[jj]), hub(h), j(jj)
+    {
+        static_cast<MultiOutputExpr<T>*>(hub.get())->outputs[j] = this;
+    }
+
+    ~OutputExpr()
+    {
+        static_cast<MultiOutputExpr<T>*>(hub.get())->outputs[j] = nullptr;
+        dispose(hub);
+    }
+
+    std::size_t arity() const override { return 1; }
+
+    Expr<T>* operand(std::size_t /* i */) const override { return hub.get(); }
+
+    void partials(T* d) const override
+    {
+        d[0] = 0.0; // the derivatives flow through the hub expression node in its pullback instead
+    }
+
+    void evaluate() override
+    {
+        this->val = static_cast<MultiOutputExpr<T>*>(hub.get())->values[j];
+    }
+};
+
+/// Return the output expression nodes of an expression node with several outputs.
+template<typename T>
+auto outputs(const IntrusivePtr<MultiOutputExpr<T>>& hub) -> std::vector<ExprPtr<T>>
+{
+    std::vector<ExprPtr<T>> res(hub->values.size());
+    for(auto j = 0U; j < res.size(); ++j)
+        res[j] = make_expr<OutputExpr<T>>(hub, j);
+    return res;
+}
+
+/// The node in the expression tree representing a black-box function of several inputs and outputs with user-supplied derivatives (e.g., an iterative solver or a table lookup).
+/// The function is evaluated by a forward callback on the values of its inputs, and
+/// the derivatives w.r.t. its inputs by a vector-Jacobian product callback, so that
+/// none of its internal operations are recorded in the expression tree.
+template<typename T>
+struct ExternalExpr : MultiOutputExpr<T>
+{
+    using MultiOutputExpr<T>::inputs;
+    using MultiOutputExpr<T>::values;
+
+    /// The callback with signature `void(const T* x, T* y)` that writes the outputs y given the inputs x.
+    using Forward = std::function<void(const T*, T*)>;
+
+    /// The callback with signature `void(const T* x, const T* y, const T* ybar, T* xbar)` that accumulates in xbar (zero on entry) the product of ybar and the Jacobian of y w.r.t. x.
+    using Pullback = std::function<void(const T*, const T*, const T*, T*)>;
+
+    /// The forward callback.
+    Forward forward;
+
+    /// The vector-Jacobian product callback.
+    Pullback pullback;
+
+    /// The auxiliary array of the values of the inputs.
+    mutable std::vector<T> x;
+
+    /// Construct an ExternalExpr object with given callbacks, inputs and number of outputs.
+    ExternalExpr(Forward f, Pullback p, std::vector<ExprPtr<T>> in, std::size_t m)
+    : MultiOutputExpr<T>(std::move(in), m), forward(std::move(f)), pullback(std::move(p))
+    {
+        evaluate();
+    }
+
+    void evaluate() override
+    {
+        gather();
+        forward(x.data(), values.data());
+    }
+
+    void vjp(const T* w, T* d) const override
+    {
+        gather();
+        std::fill(d, d + inputs.size(), T(0.0));
+        pullback(x.data(), values.data(), w, d);
+    }
+
+    /// Copy the current values of the inputs into @ref x.
+    void gather() const
+    {
+        x.resize(inputs.size());
+        for(auto i = 0U; i < inputs.size(); ++i)
+            x[i] = inputs[i]->val;
+    }
+};
+
+/// Return the outputs of a black-box function of given variables, recorded as a single expression node with user-supplied derivatives (see @ref ExternalExpr).
+/// Only first-order derivatives of the outputs are supported.
+/// @param forward The callback with signature `void(const T* x, T* y)` that writes the m outputs y given the inputs x.
+/// @param pullback The callback with signature `void(const T* x, const T* y, const T* ybar, T* xbar)` that accumulates in xbar (zero on entry) the derivatives w.r.t. x of the sum of ybar[j] * y[j].
+/// @param x The inputs of the function.
+/// @param m The number of outputs of the function.
+template<typename T, typename Forward, typename Pullback>
+auto external(Forward&& forward, Pullback&& pullback, const std::vector<Variable<T>>& x, std::size_t m) -> std::vector<Variable<T>>
+{
+    static_assert(isArithmetic<T>, "External functions support only first-order derivatives.");
+
+    std::vector<ExprPtr<T>> inputs(x.size());
+    for(auto i = 0U; i < x.size(); ++i)
+        inputs[i] = x[i].expr;
+
+    auto hub = make_expr<ExternalExpr<T>>(std::forward<Forward>(forward), std::forward<Pullback>(pullback), std::move(inputs), m);
+    const auto out = outputs<T>(hub);
+
+    return std::vector<Variable<T>>(out.begin(), out.end());
+}
+
+/// The topologically ordered list of the expression nodes in an expression tree (also known as a Wengert list).
+/// Each expression node appears only once in the tape, after all of its child
+/// expression nodes, so that a single reverse sweep over the tape visits every
+/// node exactly once, regardless of how many times it is shared in the tree.
+template<typename T>
+struct Tape
+{
+    /// The expression nodes in topological order (child expression nodes before their parents).
+    std::vector<Expr<T>*> nodes;
+
+    /// The positions in @ref operands where the child node indices of each expression node start.
+    std::vector<std::size_t> offsets;
+
+    /// The indices in @ref nodes of the child expression nodes of each expression node.
+    std::vector<std::size_t> operands;
+
+    /// The derivatives of the root expression node w.r.t. each expression node in the tape (the adjoints).
+    /// In vector mode, the derivatives of each root expression node (each lane) are stored contiguously for each expression node.
+    std::vector<T> adjoints;
+
+    /// The number of root expression nodes whose derivatives are computed together in a reverse sweep (see @ref propagate).
+    std::size_t lanes = 1;
+
+    /// The lane whose derivatives are read by @ref adjoint.
+    std::size_t lane = 0;
+
+    /// The derivative expressions of the root expression node w.r.t. each expression node in the tape (null if zero).
+    std::vector<ExprPtr<T>> adjointsx;
+
+    /// The directional derivatives of each expression node in the tape along given tangents of its leaf nodes (see @ref propagatetangents).
+    std::vector<T> tangents;
+
+    /// The directional derivatives of the adjoints of each expression node in the tape along the same tangents (the second-order adjoints).
+    std::vector<T> adjointtangents;
+
+    /// The nonzero second-order derivatives of the root expression node w.r.t. pairs of expression nodes in the tape (see @ref propagateedges).
+    /// The derivative w.r.t. a pair of expression nodes is stored in the list of the
+    /// one visited first in the reverse sweep, together with the index of the other.
+    std::vector<std::vector<std::pair<std::size_t, T>>> edges;
+
+    /// The auxiliary array of partial derivatives of an expression node w.r.t. its child expression nodes.
+    std::vector<T> buffer;
+
+    /// The auxiliary array of derivatives of the root expression nodes of all lanes w.r.t. the child expression nodes of an expression node with several outputs (see @ref Expr::pullbacks).
+    std::vector<T> bufferlanes;
+
+    /// The auxiliary array of second-order partial derivatives of an expression node w.r.t. its child expression nodes (see @ref Expr::nonzeros2).
+    std::vector<T> buffer2;
+
+    /// The auxiliary list of nonzero second-order partial derivatives of an expression node w.r.t. pairs of its child expression nodes.
+    std::vector<std::tuple<std::size_t, std::size_t, T>> nonzeros;
+
+    /// The auxiliary array of directional derivatives of the partial derivatives of an expression node (see @ref propagatetangents).
+    std::vector<T> bufferdot;
+
+    /// The auxiliary array of partial derivative expressions of an expression node w.r.t. its child expression nodes.
+    std::vector<ExprPtr<T>> bufferx;
+
+    /// The auxiliary stack used in the depth-first traversal of the expression tree.
+    std::vector<std::pair<Expr<T>*, bool>> stack;
+
+    /// The indices the expression nodes had before they were recorded in this tape (see @ref restore).
+    std::vector<std::size_t> previous;
+
+    /// The flags indicating which expression nodes in the tape have several outputs (see @ref MultiOutputExpr).
+    std::vector<char> multioutputs;
+
+    /// The operation codes of the expression nodes in the tape (see @ref partials).
+    std::vector<Opcode> opcodes;
+
+    /// The values of the expression nodes in the tape (when they were recorded or last updated), stored contiguously for the reverse sweeps.
+    std::vector<T> values;
+
+    /// The constants stored in the expression nodes in the tape (e.g., the factor of a @ref ScaleExpr node or the divisor of a @ref QuotientExpr node), or zero.
+    std::vector<T> immediates;
+
+    /// The partial derivatives of each expression node w.r.t. its child expression nodes, at the same positions as their indices in @ref operands (see @ref store).
+    std::vector<T> weights;
+
+    /// The flag that indicates whether the partial derivatives in @ref weights are kept up to date and used in the sweeps.
+    bool stored = false;
+
+    /// The flags that indicate which expression nodes in the tape depend on the variables of interest (all of them if empty, see @ref activate).
+    std::vector<char> actives;
+
+    /// Construct a default Tape object.
+    Tape() = default;
+
+    /// Construct a Tape object with the expression nodes in the expression tree of a given root node.
+    explicit Tape(Expr<T>* root) { record(root); }
+
+    /// Record the expression nodes in the expression tree of a given root node (the root node is the last one in the tape).
+    void record(Expr<T>* root)
+    {
+        record(&root, 1);
+    }
+
+    /// Record the expression nodes in the expression trees of given root nodes.
+    void record(Expr<T>* const* roots, std::size_t count)
+    {
+        nodes.clear();
+        offsets.assign(1, 0);
+        operands.clear();
+        previous.clear();
+        multioutputs.clear();
+        opcodes.clear();
+        values.clear();
+        immediates.clear();
+        weights.clear();
+        stored = false;
+        actives.clear();
+
+        std::size_t maxarity = 0;
+
+        stack.clear();
+        for(auto k = count; k > 0; --k)
+            stack.emplace_back(roots[k - 1], false);
+
+        while(!stack.empty())
+        {
+            const auto [e, visited] = stack.back();
+            stack.pop_back();
+
+            if(contains(e))
+                continue;
+
+            const auto arity = e->arity();
+
+            if(visited) // all child expression nodes of e are in the tape already
+            {
+                for(auto i = 0U; i < arity; ++i)
+                    operands.push_back(e->operand(i)->index);
+                offsets.push_back(operands.size());
+                previous.push_back(e->index);
+                multioutputs.push_back(e->multioutput());
+                if constexpr(isArithmetic<T>)
+                {
+                    const auto op = e->opcode();
+                    opcodes.push_back(op);
+                    values.push_back(e->val);
+                    immediates.push_back(op == Opcode::Scale ? static_cast<ScaleExpr<T>*>(e)->c : op == Opcode::Quotient ? static_cast<QuotientExpr<T>*>(e)->c : T(0.0));
+                }
+                e->index = nodes.size();
+                nodes.push_back(e);
+                maxarity = std::max(maxarity, arity);
+                continue;
+            }
+
+            stack.emplace_back(e, true);
+
+            for(auto i = arity; i > 0; --i)
+                if(!contains(e->operand(i - 1)))
+                    stack.emplace_back(e->operand(i - 1), false);
+        }
+
+        buffer.resize(maxarity);
+        bufferdot.resize(maxarity);
+        bufferx.resize(maxarity);
+    }
+
+    /// Restore the indices the expression nodes had before they were recorded in this tape.
+    /// This permits temporary tapes to be used (e.g. when comparing two expressions)
+    /// while the nodes they share with another tape are being swept in it.
+    void restore()
+    {
+        for(auto i = nodes.size(); i > 0; --i)
+            nodes[i - 1]->index = previous[i - 1];
+    }
+
+    /// Mark the expression nodes in the tape that are, or depend on, given expression nodes (activity analysis).
+    /// The reverse sweeps then skip the other expression nodes (e.g., subtrees that
+    /// depend only on constants or on other variables), so that only the derivatives
+    /// w.r.t. the given expression nodes (and those that depend on them) are correct.
+    /// @param wrt The expression nodes the derivatives are computed for.
+    /// @param count The number of expression nodes the derivatives are computed for.
+    void activate(const Expr<T>* const* wrt, std::size_t count)
+    {
+        const auto n = nodes.size();
+        actives.assign(n, 0);
+        for(auto k = 0U; k < count; ++k)
+            if(contains(wrt[k]))
+                actives[wrt[k]->index] = 1;
+        for(auto i = 0U; i < n; ++i)
+            for(auto k = offsets[i]; k < offsets[i + 1] && !actives[i]; ++k)
+                actives[i] = actives[operands[k]];
+    }
+
+    /// Return true if the expression node at given position in the tape has been found not to depend on the variables of interest (see @ref activate).
+    bool inactive(std::size_t i) const
+    {
+        return !actives.empty() && !actives[i];
+    }
+
+    /// Return true if a given expression node has been recorded in this tape.
+    bool contains(const Expr<T>* e) const
+    {
+        return e->index < nodes.size() && nodes[e->index] == e;
+    }
+
+    /// Return the derivative of the root expression node w.r.t. a given expression node (zero if not in the tape).
+    T adjoint(const Expr<T>* e) const
+    {
+        return adjoint(e, lane);
+    }
+
+    /// Return the derivative of the root expression node of a given lane w.r.t. a given expression node (zero if not in the tape).
+    T adjoint(const Expr<T>* e, std::size_t l) const
+    {
+        return contains(e) ? adjoints[e->index * lanes + l] : T(0.0);
+    }
+
+    /// Return the derivative expression of the root expression node w.r.t. a given expression node (zero if not in the tape).
+    ExprPtr<T> adjointx(const Expr<T>* e) const
+    {
+        return contains(e) && adjointsx[e->index] ? adjointsx[e->index] : constant<T>(0.0);
+    }
+
+    /// Update the values of all expression nodes in the tape, in topological order.
+    void update()
+    {
+        for(auto* e : nodes)
+            e->evaluate();
+        if constexpr(isArithmetic<T>)
+            for(auto i = 0U; i < nodes.size(); ++i)
+                values[i] = nodes[i]->val;
+        if(stored)
+            store();
+    }
+
+    /// Compute and store the partial derivatives of all expression nodes in the tape w.r.t. their child expression nodes.
+    /// From then on, and until the next call to @ref record, the partial derivatives
+    /// are recomputed only when the tape is updated (see @ref update), and the sweeps
+    /// only multiply and accumulate them. This pays off when the tape is swept many
+    /// times for the same values (e.g., once per chunk of rows of a Jacobian matrix),
+    /// as the partial derivatives of nodes such as pow, erf or hypot are expensive.
+    void store()
+    {
+        weights.resize(operands.size());
+        for(auto i = 0U; i < nodes.size(); ++i)
+            if(offsets[i] != offsets[i + 1] && !multioutputs[i] && !inactive(i))
+                partials(i, weights.data() + offsets[i]);
+        stored = true;
+    }
+
+    /// Return the partial derivatives of the expression node at given position in the tape w.r.t. its child expression nodes.
+    /// These are the ones stored in @ref weights if @ref store has been called, otherwise they are computed in @ref buffer.
+    const T* local(std::size_t i)
+    {
+        if(stored)
+            return weights.data() + offsets[i];
+        partials(i, buffer.data());
+        return buffer.data();
+    }
+
+    /// Write the partial derivatives of the expression node at given position in the tape w.r.t. its child expression nodes.
+    /// The partial derivatives of the most common expression node types are computed
+    /// here with a switch over their operation codes, from the values stored
+    /// contiguously in the tape, instead of with a virtual call to @ref Expr::partials.
+    /// @param i The position of the expression node in the tape.
+    /// @param d The array where the partial derivatives are written.
+    void partials(std::size_t i, T* d) const
+    {
+        if constexpr(!isArithmetic<T>)
+        {
+            nodes[i]->partials(d);
+        }
+        else
+        {
+            const auto* x = operands.data() + offsets[i];
+            switch(opcodes[i])
+            {
+                case Opcode::Identity: d[0] = 1.0; break;
+                case Opcode::Negative: d[0] = -1.0; break;
+                case Opcode::Scale: d[0] = immediates[i]; break;
+                case Opcode::Quotient: d[0] = 1.0 / immediates[i]; break;
+                case Opcode::Shift: d[0] = 1.0; break;
+                case Opcode::Add: d[0] = 1.0; d[1] = 1.0; break;
+                case Opcode::Sub: d[0] = 1.0; d[1] = -1.0; break;
+                case Opcode::Mul: d[0] = values[x[1]]; d[1] = values[x[0]]; break;
+                case Opcode::Div:
+                {
+                    const T aux = 1.0 / values[x[1]];
+                    d[0] = aux;
+                    d[1] = -values[x[0]] * aux * aux;
+                    break;
+                }
+                case Opcode::Sin: d[0] = std::cos(values[x[0]]); break;
+                case Opcode::Cos: d[0] = -std::sin(values[x[0]]); break;
+                case Opcode::Tanh:
+                {
+                    const T aux = 1.0 / std::cosh(values[x[0]]);
+                    d[0] = aux * aux;
+                    break;
+                }
+                case Opcode::Exp: d[0] = values[i]; break;
+                case Opcode::Log: d[0] = 1.0 / values[x[0]]; break;
+                case Opcode::Sqrt: d[0] = 1.0 / (2.0 * std::sqrt(values[x[0]])); break;
+                case Opcode::Sum: std::fill(d, d + (offsets[i + 1] - offsets[i]), T(1.0)); break;
+                case Opcode::Min: d[0] = values[x[0]] < values[x[1]] ? 1.0 : 0.0; d[1] = 1.0 - d[0]; break;
+                case Opcode::Max: d[0] = values[x[0]] > values[x[1]] ? 1.0 : 0.0; d[1] = 1.0 - d[0]; break;
+                default: nodes[i]->partials(d);
+            }
+        }
+    }
+
+    /// Compute the derivatives of the root expression node w.r.t. every expression node in the tape in a single reverse sweep.
+    /// @param wprime The derivative of the final root expression node w.r.t. the root expression node of the tape.
+    void propagate(const T& wprime)
+    {
+        const auto n = nodes.size();
+
+        lanes = 1;
+        lane = 0;
+        adjoints.assign(n, T(0.0));
+
+        if(n == 0)
+            return;
+
+        adjoints[n - 1] = wprime;
+
+        T* d = buffer.data();
+
+        for(auto i = n; i > 0; --i)
+        {
+            const auto begin = offsets[i - 1];
+            const auto end = offsets[i];
+
+            if(begin == end || inactive(i - 1))
+                continue;
+
+            if(multioutputs[i - 1])
+            {
+                nodes[i - 1]->pullback(*this, d);
+                for(auto k = begin; k < end; ++k)
+                    adjoints[operands[k]] += d[k - begin];
+                continue;
+            }
+
+            const T w = adjoints[i - 1];
+
+            if constexpr(isArithmetic<T>)
+                if(w == 0.0) // skip expression nodes that do not contribute to the derivatives (e.g., in discarded branches of conditional expressions)
+                    continue;
+
+            const T* pd = local(i - 1);
+
+            for(auto k = begin; k < end; ++k)
+                adjoints[operands[k]] += w * pd[k - begin];
+        }
+    }
+
+    /// Compute the derivatives of several root expression nodes w.r.t. every expression node in the tape in a single reverse sweep (vector mode).
+    /// The derivatives of the root expression nodes are carried together as
+    /// vectors with one lane per root expression node, so that the expression
+    /// tree is traversed once for all of them, instead of once for each.
+    /// @param roots The root expression nodes (each recorded in the tape).
+    /// @param count The number of root expression nodes (the number of lanes).
+    void propagate(Expr<T>* const* roots, std::size_t count)
+    {
+        const auto n = nodes.size();
+
+        lanes = count;
+        lane = 0;
+        adjoints.assign(n * lanes, T(0.0));
+
+        for(auto k = 0U; k < count; ++k)
+        {
+            assert(contains(roots[k]));
+            adjoints[roots[k]->index * lanes + k] += 1.0;
+        }
+
+        for(auto i = n; i > 0; --i)
+        {
+            const auto begin = offsets[i - 1];
+            const auto end = offsets[i];
+
+            if(begin == end || inactive(i - 1))
+                continue;
+
+            if(multioutputs[i - 1]) // a single pullback for all lanes, e.g. so that a checkpointed region is recomputed once
+            {
+                bufferlanes.resize((end - begin) * lanes);
+                nodes[i - 1]->pullbacks(*this, bufferlanes.data());
+                for(auto k = begin; k < end; ++k)
+                    for(auto l = 0U; l < lanes; ++l)
+                        adjoints[operands[k] * lanes + l] += bufferlanes[(k - begin) * lanes + l];
+                continue;
+            }
+
+            const T* w = adjoints.data() + (i - 1) * lanes;
+
+            if constexpr(isArithmetic<T>)
+                if(std::all_of(w, w + lanes, [](const T& wl) { return wl == 0.0; }))
+                    continue;
+
+            const T* pd = local(i - 1);
+
+            for(auto k = begin; k < end; ++k)
+            {
+                T* a = adjoints.data() + operands[k] * lanes;
+                const T dk = pd[k - begin];
+                for(auto l = 0U; l < lanes; ++l)
+                    a[l] += dk * w[l];
+            }
+        }
+    }
+
+    /// Compute the adjoints and their directional derivatives along given tangents (forward-over-reverse) in a forward and a reverse sweep.
+    /// The tangents of the expression nodes of interest must be set in @ref tangents
+    /// (of the same size as @ref nodes, zero for the other nodes) beforehand. The
+    /// tangent set for an expression node with child expression nodes is added to
+    /// the one computed from them, so that dependent variables can be seeded too.
+    /// The directional derivatives of the adjoints w.r.t. these nodes are then the
+    /// product of the Hessian of the root expression node and their tangents.
+    /// @param wprime The derivative of the final root expression node w.r.t. the root expression node of the tape.
+    void propagatetangents(const T& wprime)
+    {
+        const auto n = nodes.size();
+
+        assert(tangents.size() == n);
+
+        lanes = 1;
+        lane = 0;
+        adjoints.assign(n, T(0.0));
+        adjointtangents.assign(n, T(0.0));
+
+        if(n == 0)
+            return;
+
+        T* ddot = bufferdot.data(); // the directional derivatives of the partial derivatives
+
+        for(auto i = 0U; i < n; ++i) // forward sweep: the directional derivatives of the expression nodes
+        {
+            const auto begin = offsets[i];
+            const auto end = offsets[i + 1];
+
+            if(begin == end)
+                continue;
+
+            if(multioutputs[i])
+                throw std::logic_error("Second-order derivatives of expression nodes with several outputs are not supported.");
+
+            const T* pd = local(i);
+
+            T tangent = 0.0;
+            for(auto k = begin; k < end; ++k)
+                tangent += pd[k - begin] * tangents[operands[k]];
+            tangents[i] += tangent;
+        }
+
+        adjoints[n - 1] = wprime;
+
+        for(auto i = n; i > 0; --i) // reverse sweep: the adjoints and their directional derivatives
+        {
+            const auto begin = offsets[i - 1];
+            const auto end = offsets[i];
+
+            if(begin == end)
+                continue;
+
+            const T w = adjoints[i - 1];
+            const T wdot = adjointtangents[i - 1];
+
+            if(w == 0.0 && wdot == 0.0)
+                continue;
+
+            const T* pd = local(i - 1);
+
+            nonzeros.clear();
+            nodes[i - 1]->nonzeros2(buffer2, nonzeros);
+
+            std::fill(ddot, ddot + (end - begin), T(0.0));
+            for(const auto& [a, b, value] : nonzeros)
+            {
+                ddot[a] += value * tangents[operands[begin + b]];
+                if(a != b)
+                    ddot[b] += value * tangents[operands[begin + a]];
+            }
+
+            for(auto k = begin; k < end; ++k)
+            {
+                adjoints[operands[k]] += w * pd[k - begin];
+                adjointtangents[operands[k]] += wdot * pd[k - begin] + w * ddot[k - begin];
+            }
+        }
+    }
+
+    /// Compute the adjoints and the nonzero second-order derivatives of the root expression node in a single reverse sweep (edge pushing).
+    /// Each expression node visited in the sweep pushes the second-order
+    /// derivatives w.r.t. pairs involving it to pairs involving its child
+    /// expression nodes, and creates new ones from its own second-order partial
+    /// derivatives, weighted by its adjoint. At the end, the nonzero entries left
+    /// in @ref edges are those between leaf expression nodes, and only pairs of
+    /// expression nodes that interact nonlinearly have ever been stored.
+    /// @param wprime The derivative of the final root expression node w.r.t. the root expression node of the tape.
+    void propagateedges(const T& wprime)
+    {
+        const auto n = nodes.size();
+
+        lanes = 1;
+        lane = 0;
+        adjoints.assign(n, T(0.0));
+        edges.assign(n, {});
+
+        if(n == 0)
+            return;
+
+        adjoints[n - 1] = wprime;
+
+        // Add a contribution to the second-order derivative w.r.t. the pair of expression nodes (i, j),
+        // stored with the one visited first in the sweep (leaf expression nodes are never visited)
+        auto add = [&](std::size_t i, std::size_t j, const T& value)
+        {
+            if(value == 0.0)
+                return;
+            const auto leafi = offsets[i] == offsets[i + 1];
+            const auto leafj = offsets[j] == offsets[j + 1];
+            if(leafi == leafj ? i < j : leafi)
+                std::swap(i, j);
+            edges[i].emplace_back(j, value);
+        };
+
+        for(auto i = n; i > 0; --i)
+        {
+            const auto begin = offsets[i - 1];
+            const auto end = offsets[i];
+
+            if(begin == end)
+                continue;
+
+            if(multioutputs[i - 1])
+                throw std::logic_error("Second-order derivatives of expression nodes with several outputs are not supported.");
+
+            auto& pairs = edges[i - 1];
+
+            const T w = adjoints[i - 1];
+
+            if(w == 0.0 && pairs.empty())
+                continue;
+
+            // Merge the contributions to the same pair of expression nodes
+            std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            auto last = pairs.begin();
+            for(auto it = pairs.begin(); it != pairs.end(); ++it)
+            {
+                if(last != it && last->first == it->first)
+                    last->second += it->second;
+                else if(last != it)
+                    *(++last) = *it;
+            }
+            if(!pairs.empty())
+                pairs.erase(last + 1, pairs.end());
+
+            const T* pd = local(i - 1);
+
+            // Pushing: the second-order derivatives w.r.t. pairs involving this expression node go to pairs involving its child expression nodes
+            for(const auto& [p, value] : pairs)
+            {
+                if(p == i - 1)
+                {
+                    for(auto a = begin; a < end; ++a)
+                        for(auto b = a; b < end; ++b)
+                            add(operands[a], operands[b], (a != b && operands[a] == operands[b] ? 2.0 : 1.0) * pd[a - begin] * pd[b - begin] * value);
+                }
+                else
+                {
+                    for(auto a = begin; a < end; ++a)
+                        add(operands[a], p, (operands[a] == p ? 2.0 : 1.0) * pd[a - begin] * value);
+                }
+            }
+
+            pairs.clear();
+            pairs.shrink_to_fit();
+
+            // Creating: the second-order partial derivatives of this expression node weighted by its adjoint
+            if(w != 0.0)
+            {
+                nonzeros.clear();
+                nodes[i - 1]->nonzeros2(buffer2, nonzeros);
+
+                for(const auto& [a, b, value] : nonzeros)
+                    add(operands[begin + a], operands[begin + b], (a != b && operands[begin + a] == operands[begin + b] ? 2.0 : 1.0) * w * value);
+            }
+
+            // The adjoints of the child expression nodes
+            for(auto k = begin; k < end; ++k)
+                adjoints[operands[k]] += w * pd[k - begin];
+        }
+    }
+
+    /// Compute the derivative expressions of the root expression node w.r.t. every expression node in the tape in a single reverse sweep.
+    /// @param wprime The derivative expression of the final root expression node w.r.t. the root expression node of the tape.
+    void propagatex(const ExprPtr<T>& wprime)
+    {
+        const auto n = nodes.size();
+
+        adjointsx.assign(n, nullptr);
+
+        if(n == 0)
+            return;
+
+        adjointsx[n - 1] = wprime;
+
+        ExprPtr<T>* d = bufferx.data();
+
+        for(auto i = n; i > 0; --i)
+        {
+            const auto begin = offsets[i - 1];
+            const auto end = offsets[i];
+
+            if(begin == end || inactive(i - 1))
+                continue;
+
+            if(multioutputs[i - 1])
+                throw std::logic_error("Higher-order derivatives of expression nodes with several outputs are not supported.");
+
+            const ExprPtr<T> w = adjointsx[i - 1];
+
+            if(!w) // skip expression nodes not reached from the root expression node
+                continue;
+
+            nodes[i - 1]->partialsx(d);
+
+            for(auto k = begin; k < end; ++k)
+            {
+                if(inactive(operands[k])) // no derivative expressions are built for expression nodes that do not depend on the variables of interest
+                    continue;
+                auto& a = adjointsx[operands[k]];
+                const auto aux = d[k - begin] ? w * d[k - begin] : w;
+                a = a ? a + aux : aux;
+            }
+        }
+
+        std::fill(bufferx.begin(), bufferx.end(), nullptr);
+    }
+};
+
+//------------------------------------------------------------------------------
+// CONVENIENT FUNCTIONS
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// ARITHMETIC OPERATORS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> operator+(const ExprPtr<T>& r) { return r; }
+template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& r) { return make_folded_expr<NegativeExpr<T>>(-r->val, r); }
+
+// Products, quotients and sums with constants are stored in ScaleExpr, QuotientExpr and ShiftExpr nodes, without a ConstantExpr node
+template<typename T> ExprPtr<T> scale(const ExprPtr<T>& x, const T& c) { return make_folded_expr<ScaleExpr<T>>(c * x->val, x, c); }
+template<typename T> ExprPtr<T> quotient(const ExprPtr<T>& x, const T& c) { return make_folded_expr<QuotientExpr<T>>(x->val / c, x, c); }
+template<typename T> ExprPtr<T> shift(const ExprPtr<T>& x, const T& c) { return make_folded_expr<ShiftExpr<T>>(x->val + c, x, c); }
+
+template<typename T>
+ExprPtr<T> operator+(const ExprPtr<T>& l, const ExprPtr<T>& r)
+{
+    if(l->isconstant()) return shift(r, l->val);
+    if(r->isconstant()) return shift(l, r->val);
+    return make_cached_expr<AddExpr<T>>(l->val + r->val, l, r);
+}
+
+template<typename T>
+ExprPtr<T> operator-(const ExprPtr<T>& l, const ExprPtr<T>& r)
+{
+    if(r->isconstant()) return shift(l, T(-r->val));
+    if(l->isconstant()) return shift(-r, l->val);
+    return make_cached_expr<SubExpr<T>>(l->val - r->val, l, r);
+}
+
+template<typename T>
+ExprPtr<T> operator*(const ExprPtr<T>& l, const ExprPtr<T>& r)
+{
+    if(l->isconstant()) return scale(r, l->val);
+    if(r->isconstant()) return scale(l, r->val);
+    return make_cached_expr<MulExpr<T>>(l->val * r->val, l, r);
+}
+
+template<typename T>
+ExprPtr<T> operator/(const ExprPtr<T>& l, const ExprPtr<T>& r)
+{
+    if(r->isconstant()) return quotient(l, r->val);
+    return make_folded_expr<DivExpr<T>>(l->val / r->val, l, r);
+}
+
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator+(const U& l, const ExprPtr<T>& r) { return shift(r, T(l)); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator-(const U& l, const ExprPtr<T>& r) { return shift(-r, T(l)); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator*(const U& l, const ExprPtr<T>& r) { return scale(r, T(l)); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator/(const U& l, const ExprPtr<T>& r) { return constant<T>(l) / r; }
+
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator+(const ExprPtr<T>& l, const U& r) { return shift(l, T(r)); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator-(const ExprPtr<T>& l, const U& r) { return shift(l, T(-T(r))); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator*(const ExprPtr<T>& l, const U& r) { return scale(l, T(r)); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator/(const ExprPtr<T>& l, const U& r) { return quotient(l, T(r)); }
+
+//------------------------------------------------------------------------------
+// TRIGONOMETRIC FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> sin(const ExprPtr<T>& x) { return make_folded_expr<SinExpr<T>>(sin(x->val), x); }
+template<typename T> ExprPtr<T> cos(const ExprPtr<T>& x) { return make_folded_expr<CosExpr<T>>(cos(x->val), x); }
+template<typename T> ExprPtr<T> tan(const ExprPtr<T>& x) { return make_folded_expr<TanExpr<T>>(tan(x->val), x); }
+template<typename T> ExprPtr<T> asin(const ExprPtr<T>& x) { return make_folded_expr<ArcSinExpr<T>>(asin(x->val), x); }
+template<typename T> ExprPtr<T> acos(const ExprPtr<T>& x) { return make_folded_expr<ArcCosExpr<T>>(acos(x->val), x); }
+template<typename T> ExprPtr<T> atan(const ExprPtr<T>& x) { return make_folded_expr<ArcTanExpr<T>>(atan(x->val), x); }
+template<typename T> ExprPtr<T> atan2(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_folded_expr<ArcTan2Expr<T>>(atan2(l->val, r->val), l, r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> atan2(const U& l, const ExprPtr<T>& r) { return make_folded_expr<ArcTan2Expr<T>>(atan2(l, r->val), constant<T>(l), r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> atan2(const ExprPtr<T>& l, const U& r) { return make_folded_expr<ArcTan2Expr<T>>(atan2(l->val, r), l, constant<T>(r)); }
+
+
+//------------------------------------------------------------------------------
+// HYPOT2 FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> hypot(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_folded_expr<Hypot2Expr<T>>(hypot(l->val, r->val), l, r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const U& l, const ExprPtr<T>& r) { return make_folded_expr<Hypot2Expr<T>>(hypot(l, r->val), constant<T>(l), r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l, const U& r) { return make_folded_expr<Hypot2Expr<T>>(hypot(l->val, r), l, constant<T>(r)); }
+
+//------------------------------------------------------------------------------
+// HYPOT3 FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> hypot(const ExprPtr<T>& l, const ExprPtr<T>& c, const ExprPtr<T>& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l->val,c->val, r->val), l, c, r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l, const ExprPtr<T>& c, const U& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l->val, c->val, r), l, c, constant<T>(r)); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const U& l, const ExprPtr<T>& c, const ExprPtr<T>& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l, c->val, r->val), constant<T>(l), c, r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l,const U& c, const ExprPtr<T>& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l->val, c, r->val), l, constant<T>(c), r); }
+template<typename T, typename U, typename V, Requires<isArithmetic<U> && isArithmetic<V>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l, const U& c, const V& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l->val, c, r), l, constant<T>(c), constant<T>(r)); }
+template<typename T, typename U, typename V, Requires<isArithmetic<U> && isArithmetic<V>> = true> ExprPtr<T> hypot(const U& l, const ExprPtr<T>& c, const V& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l, c->val, r), constant<T>(l), c, constant<T>(r)); }
+template<typename T, typename U, typename V, Requires<isArithmetic<U> && isArithmetic<V>> = true> ExprPtr<T> hypot(const V& l, const U& c, const ExprPtr<T>& r) { return make_folded_expr<Hypot3Expr<T>>(hypot(l, c, r->val), constant<T>(l), constant<T>(c), r); }
+
+//------------------------------------------------------------------------------
+// HYPERBOLIC FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> sinh(const ExprPtr<T>& x) { return make_folded_expr<SinhExpr<T>>(sinh(x->val), x); }
+template<typename T> ExprPtr<T> cosh(const ExprPtr<T>& x) { return make_folded_expr<CoshExpr<T>>(cosh(x->val), x); }
+template<typename T> ExprPtr<T> tanh(const ExprPtr<T>& x) { return make_folded_expr<TanhExpr<T>>(tanh(x->val), x); }
+
+//------------------------------------------------------------------------------
+// EXPONENTIAL AND LOGARITHMIC FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> exp(const ExprPtr<T>& x) { return make_folded_expr<ExpExpr<T>>(exp(x->val), x); }
+template<typename T> ExprPtr<T> log(const ExprPtr<T>& x) { return make_folded_expr<LogExpr<T>>(log(x->val), x); }
+template<typename T> ExprPtr<T> log10(const ExprPtr<T>& x) { return make_folded_expr<Log10Expr<T>>(log10(x->val), x); }
+
+//------------------------------------------------------------------------------
+// POWER FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> sqrt(const ExprPtr<T>& x) { return make_folded_expr<SqrtExpr<T>>(sqrt(x->val), x); }
+template<typename T> ExprPtr<T> pow(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_folded_expr<PowExpr<T>>(pow(l->val, r->val), l, r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> pow(const U& l, const ExprPtr<T>& r) { return make_folded_expr<PowConstantLeftExpr<T>>(pow(l, r->val), constant<T>(l), r); }
+template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> pow(const ExprPtr<T>& l, const U& r) { return make_folded_expr<PowConstantRightExpr<T>>(pow(l->val, r), l, constant<T>(r)); }
+
+//------------------------------------------------------------------------------
+// OTHER FUNCTIONS
+//------------------------------------------------------------------------------
+template<typename T> ExprPtr<T> abs(const ExprPtr<T>& x) { return make_folded_expr<AbsExpr<T>>(abs(x->val), x); }
+template<typename T> ExprPtr<T> abs2(const ExprPtr<T>& x) { return x * x; }
+template<typename T> ExprPtr<T> conj(const ExprPtr<T>& x) { return x; }
+template<typename T> ExprPtr<T> real(const ExprPtr<T>& x) { return x; }
+template<typename T> ExprPtr<T> imag(const ExprPtr<T>&) { return constant<T>(0.0); }
+template<typename T> ExprPtr<T> erf(const ExprPtr<T>& x) { return make_folded_expr<ErfExpr<T>>(erf(x->val), x); }
+
+//------------------------------------------------------------------------------
+// COMPILE-TIME EXPRESSION TEMPLATES
+//------------------------------------------------------------------------------
+
+struct NegOp  {};  // NEGATIVE OPERATOR
+struct AddOp  {};  // ADDITION OPERATOR
+struct SubOp  {};  // SUBTRACTION OPERATOR
+struct MulOp  {};  // MULTIPLICATION OPERATOR
+struct DivOp  {};  // DIVISION OPERATOR
+struct SinOp  {};  // SINE OPERATOR
+struct CosOp  {};  // COSINE OPERATOR
+struct TanOp  {};  // TANGENT OPERATOR
+struct TanhOp {};  // HYPERBOLIC TANGENT OPERATOR
+struct ExpOp  {};  // EXPONENTIAL OPERATOR
+struct LogOp  {};  // NATURAL LOGARITHM OPERATOR
+struct SqrtOp {};  // SQUARE ROOT OPERATOR
+
+/// The leaf of a compile-time expression representing a variable (see @ref lazy).
+/// The compile-time expression refers to the expression node of the variable
+/// without owning it, and must not outlive the statement in which it is used.
+template<typename T>
+struct LazyVariable
 {
-    // Using declarations for data members of base class
-    using BinaryExpr<T>::val;
-    using BinaryExpr<T>::l;
-    using BinaryExpr<T>::r;
-
-    PowConstantLeftExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
-
-    void propagate(const T& wprime) override
-    {
-        const auto lval = l->val;
-        const auto rval = r->val;
-        const auto aux = wprime * pow(lval, rval - 1);
-        const auto auxr = lval == 0.0 ? 0.0 : lval * log(lval); // since x*log(x) -> 0 as x -> 0
-        r->propagate(aux * auxr);
-    }
+    using ValueType = T;
 
-    void propagatex(const ExprPtr<T>& wprime) override
-    {
-        const auto aux = wprime * pow(l, r - 1);
-        const auto auxr = l == 0.0 ? 0.0*l : l * log(l); // since x*log(x) -> 0 as x -> 0
-        r->propagatex(aux * auxr);
-    }
+    /// The number of variables in this compile-time expression.
+    static constexpr std::size_t leaves = 1;
 
-    void update() override
-    {
-        r->update();
-        this->val = pow(l->val, r->val);
-    }
-};
+    /// The expression node of the variable.
+    Expr<T>* e;
 
-template<typename T>
-struct PowConstantRightExpr : BinaryExpr<T>
-{
-    // Using declarations for data members of base class
-    using BinaryExpr<T>::val;
-    using BinaryExpr<T>::l;
-    using BinaryExpr<T>::r;
+    /// The value of the variable.
+    T val;
 
-    PowConstantRightExpr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+    /// Construct a LazyVariable object with given expression node.
+    explicit LazyVariable(Expr<T>* x) : e(x), val(x->val) {}
 
-    void propagate(const T& wprime) override
-    {
-        l->propagate(wprime * pow(l->val, r->val - 1) * r->val); // pow(l, r)'l = r * pow(l, r - 1) * l'
-    }
+    /// Update and return the value of this compile-time expression.
+    T evaluate() { return val = e->val; }
 
-    void propagatex(const ExprPtr<T>& wprime) override
-    {
-        l->propagatex(wprime * pow(l, r - 1) * r);
-    }
+    /// Write the derivative of the statement w.r.t. this variable at position Offset.
+    template<std::size_t Offset>
+    void gradient(const T& w, T* d) const { d[Offset] = w; }
 
-    void update() override
-    {
-        l->update();
-        this->val = pow(l->val, r->val);
-    }
+    /// Write the expression node of this variable at position Offset.
+    template<std::size_t Offset>
+    void collect(Expr<T>** x) const { x[Offset] = e; }
 };
 
+/// The leaf of a compile-time expression representing a constant.
 template<typename T>
-struct SqrtExpr : UnaryExpr<T>
+struct LazyConstant
 {
-    // Using declarations for data members of base class
-    using UnaryExpr<T>::x;
+    using ValueType = T;
 
-    SqrtExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+    static constexpr std::size_t leaves = 0;
 
-    void propagate(const T& wprime) override
-    {
-        x->propagate(wprime / (2.0 * sqrt(x->val))); // sqrt(x)' = 1/2 * 1/sqrt(x) * x'
-    }
+    T val;
 
-    void propagatex(const ExprPtr<T>& wprime) override
-    {
-        x->propagatex(wprime / (2.0 * sqrt(x)));
-    }
+    T evaluate() { return val; }
 
-    void update() override
-    {
-        x->update();
-        this->val = sqrt(x->val);
-    }
+    template<std::size_t Offset>
+    void gradient(const T& /* w */, T* /* d */) const {}
+
+    template<std::size_t Offset>
+    void collect(Expr<T>** /* x */) const {}
 };
 
-template<typename T>
-struct AbsExpr : UnaryExpr<T>
+/// The compile-time expression representing a unary operation on a compile-time expression.
+template<typename Op, typename E>
+struct LazyUnaryExpr
 {
-    // Using declarations for data members of base class
-    using UnaryExpr<T>::x;
-    using U = VariableValueType<T>;
+    using ValueType = typename E::ValueType;
+    using T = ValueType;
 
-    AbsExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+    static constexpr std::size_t leaves = E::leaves;
 
-    void propagate(const T& wprime) override
-    {
-        if(x->val < 0.0) x->propagate(-wprime);
-        else if(x->val > 0.0) x->propagate(wprime);
-        else x->propagate(T(0));
-    }
+    E x;
+
+    T val;
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    explicit LazyUnaryExpr(const E& e) : x(e), val(apply(x.val)) {}
+
+    static T apply(const T& a)
     {
-        if(x->val < 0.0) x->propagatex(-wprime);
-        else if(x->val > 0.0) x->propagatex(wprime);
-        else x->propagate(T(0));
+        if constexpr(isSame<Op, NegOp>) return -a;
+        else if constexpr(isSame<Op, SinOp>) return sin(a);
+        else if constexpr(isSame<Op, CosOp>) return cos(a);
+        else if constexpr(isSame<Op, TanOp>) return tan(a);
+        else if constexpr(isSame<Op, TanhOp>) return tanh(a);
+        else if constexpr(isSame<Op, ExpOp>) return exp(a);
+        else if constexpr(isSame<Op, LogOp>) return log(a);
+        else return sqrt(a);
     }
 
-    void update() override
+    /// Return the derivative of this operation w.r.t. its argument.
+    T derivative() const
     {
-        x->update();
-        this->val = abs(x->val);
+        if constexpr(isSame<Op, NegOp>) return -1.0;
+        else if constexpr(isSame<Op, SinOp>) return cos(x.val);
+        else if constexpr(isSame<Op, CosOp>) return -sin(x.val);
+        else if constexpr(isSame<Op, TanOp>) { const T aux = 1.0 / cos(x.val); return aux * aux; }
+        else if constexpr(isSame<Op, TanhOp>) { const T aux = 1.0 / cosh(x.val); return aux * aux; }
+        else if constexpr(isSame<Op, ExpOp>) return val;
+        else if constexpr(isSame<Op, LogOp>) return 1.0 / x.val;
+        else return 1.0 / (2.0 * val);
     }
+
+    T evaluate() { x.evaluate(); return val = apply(x.val); }
+
+    template<std::size_t Offset>
+    void gradient(const T& w, T* d) const { x.template gradient<Offset>(w * derivative(), d); }
+
+    template<std::size_t Offset>
+    void collect(Expr<T>** e) const { x.template collect<Offset>(e); }
 };
 
-template<typename T>
-struct ErfExpr : UnaryExpr<T>
+/// The compile-time expression representing a binary operation on two compile-time expressions.
+/// The variables of the right compile-time expression are numbered after those of the left one.
+template<typename Op, typename L, typename R>
+struct LazyBinaryExpr
 {
-    // Using declarations for data members of base class
-    using UnaryExpr<T>::x;
+    using ValueType = typename L::ValueType;
+    using T = ValueType;
 
-    constexpr static auto sqrt_pi = static_cast<VariableValueType<T>>(1.7724538509055160272981674833411451872554456638435);
+    static constexpr std::size_t leaves = L::leaves + R::leaves;
 
-    ErfExpr(const T& v, const ExprPtr<T>& e) : UnaryExpr<T>(v, e) {}
+    L l;
+
+    R r;
+
+    T val;
+
+    LazyBinaryExpr(const L& a, const R& b) : l(a), r(b), val(apply(l.val, r.val)) {}
 
-    void propagate(const T& wprime) override
+    static T apply(const T& a, const T& b)
     {
-        const auto aux = 2.0 / sqrt_pi * exp(-(x->val) * (x->val)); // erf(x)' = 2/sqrt(pi) * exp(-x * x) * x'
-        x->propagate(wprime * aux);
+        if constexpr(isSame<Op, AddOp>) return a + b;
+        else if constexpr(isSame<Op, SubOp>) return a - b;
+        else if constexpr(isSame<Op, MulOp>) return a * b;
+        else return a / b;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    T evaluate() { l.evaluate(); r.evaluate(); return val = apply(l.val, r.val); }
+
+    template<std::size_t Offset>
+    void gradient(const T& w, T* d) const
     {
-        const auto aux = 2.0 / sqrt_pi * exp(-x * x);
-        x->propagatex(wprime * aux);
+        constexpr auto OffsetR = Offset + L::leaves;
+        if constexpr(isSame<Op, AddOp>)
+        {
+            l.template gradient<Offset>(w, d);
+            r.template gradient<OffsetR>(w, d);
+        }
+        else if constexpr(isSame<Op, SubOp>)
+        {
+            l.template gradient<Offset>(w, d);
+            r.template gradient<OffsetR>(-w, d);
+        }
+        else if constexpr(isSame<Op, MulOp>)
+        {
+            l.template gradient<Offset>(w * r.val, d);
+            r.template gradient<OffsetR>(w * l.val, d);
+        }
+        else
+        {
+            const T aux = 1.0 / r.val;
+            l.template gradient<Offset>(w * aux, d);
+            r.template gradient<OffsetR>(-w * l.val * aux * aux, d);
+        }
     }
 
-    void update() override
+    template<std::size_t Offset>
+    void collect(Expr<T>** e) const
     {
-        x->update();
-        this->val = erf(x->val);
+        l.template collect<Offset>(e);
+        r.template collect<Offset + L::leaves>(e);
     }
 };
 
+template<typename T> struct isLazyExprTrait { constexpr static bool value = false; };
+template<typename T> struct isLazyExprTrait<LazyVariable<T>> { constexpr static bool value = true; };
+template<typename Op, typename E> struct isLazyExprTrait<LazyUnaryExpr<Op, E>> { constexpr static bool value = true; };
+template<typename Op, typename L, typename R> struct isLazyExprTrait<LazyBinaryExpr<Op, L, R>> { constexpr static bool value = true; };
+
+/// A compile-time constant that indicates whether a type is a compile-time expression (see @ref lazy).
 template<typename T>
-struct Hypot2Expr : BinaryExpr<T>
+constexpr bool isLazyExpr = isLazyExprTrait<PlainType<T>>::value;
+
+/// The node in the expression tree representing a statement built from a compile-time expression (see @ref lazy).
+/// The child expression nodes are the variables in the compile-time expression (a
+/// variable used several times is a child expression node several times), and the
+/// partial derivatives w.r.t. them are computed by recursion over the compile-time
+/// expression, which is kept in the node so that its value can also be updated.
+template<typename T, typename E>
+struct StatementExpr : Expr<T>
 {
-    // Using declarations for data members of base class
-    using BinaryExpr<T>::val;
-    using BinaryExpr<T>::l;
-    using BinaryExpr<T>::r;
+    /// The compile-time expression of the statement.
+    E stmt;
 
-    Hypot2Expr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : BinaryExpr<T>(v, ll, rr) {}
+    /// The child expression nodes of this expression node (the variables in the statement).
+    std::array<ExprPtr<T>, E::leaves> inputs;
 
-    void propagate(const T& wprime) override
+    /// Construct a StatementExpr object with given compile-time expression.
+    explicit StatementExpr(const E& e) : Expr<T>(e.val), stmt(e)
     {
-        l->propagate(wprime * l->val / val); // sqrt(l*l + r*r)'l = 1/2 * 1/sqrt(l*l + r*r) * (2*l*l') = (l*l')/sqrt(l*l + r*r)
-        r->propagate(wprime * r->val / val); // sqrt(l*l + r*r)'r = 1/2 * 1/sqrt(l*l + r*r) * (2*r*r') = (r*r')/sqrt(l*l + r*r)
+        std::array<Expr<T>*, E::leaves> x;
+        stmt.template collect<0>(x.data());
+        for(auto i = 0U; i < E::leaves; ++i)
+            inputs[i] = ExprPtr<T>(x[i]);
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
-    {
-        l->propagatex(wprime * l / hypot(l, r));
-        r->propagatex(wprime * r / hypot(l, r));
-    }
+    ~StatementExpr() { for(auto& e : inputs) dispose(e); }
 
-    void update() override
-    {
-        l->update();
-        r->update();
-        this->val = hypot(l->val, r->val);
-    }
-};
+    std::size_t arity() const override { return E::leaves; }
 
-template<typename T>
-struct Hypot3Expr : TernaryExpr<T>
-{
-    // Using declarations for data members of base class
-    using TernaryExpr<T>::val;
-    using TernaryExpr<T>::l;
-    using TernaryExpr<T>::c;
-    using TernaryExpr<T>::r;
+    Expr<T>* operand(std::size_t i) const override { return inputs[i].get(); }
 
-    Hypot3Expr(const T& v, const ExprPtr<T>& ll, const ExprPtr<T>& cc, const ExprPtr<T>& rr) : TernaryExpr<T>(v, ll, cc, rr) {}
+    void partials(T* d) const override
+    {
+        stmt.template gradient<0>(T(1.0), d);
+    }
 
-    void propagate(const T& wprime) override
+    void nonzeros2(std::vector<T>& /* h */, std::vector<std::tuple<std::size_t, std::size_t, T>>& /* entries */) const override
     {
-        l->propagate(wprime * l->val / val);
-        c->propagate(wprime * c->val / val);
-        r->propagate(wprime * r->val / val);
+        throw std::logic_error("Second-order derivatives of statements built from compile-time expressions are not supported.");
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
+    void partialsx(ExprPtr<T>* /* d */) const override
     {
-        l->propagatex(wprime * l / hypot(l, c, r));
-        c->propagatex(wprime * c / hypot(l, c, r));
-        r->propagatex(wprime * r / hypot(l, c, r));
+        throw std::logic_error("Derivative expressions of statements built from compile-time expressions are not supported.");
     }
 
-    void update() override
+    void evaluate() override
     {
-        l->update();
-        c->update();
-        r->update();
-        this->val = hypot(l->val, c->val, r->val);
+        this->val = stmt.evaluate();
     }
 };
 
-// Any expression yielding a boolean depending on arithmetic subexpressions
-struct BooleanExpr
+/// Return the expression node of a statement built from a compile-time expression (see @ref StatementExpr).
+template<typename E>
+auto statement(const E& e) -> ExprPtr<typename E::ValueType>
 {
-    std::function<bool()> expr;
-    bool val = {};
-
-    explicit BooleanExpr(std::function<bool()> expression) : expr(std::move(expression)) { update(); }
-    operator bool() const { return val; }
+    using T = typename E::ValueType;
+    static_assert(isArithmetic<T>, "Compile-time expressions are supported only for first-order variables (e.g., var).");
+    if constexpr(E::leaves == 0)
+        return constant<T>(e.val);
+    else return make_expr<StatementExpr<T, E>>(e);
+}
 
-    void update() { val = expr(); }
+/// Return a variable as the leaf of a compile-time expression.
+/// Arithmetic operations and the functions `sin`, `cos`, `tan`, `tanh`, `exp`,
+/// `log` and `sqrt` with a compile-time expression among their arguments return
+/// compile-time expressions too, instead of expression nodes. These are turned into
+/// a single expression node when assigned to a Variable object. For example,
+/// in `var z = lazy(x) * y + sin(lazy(x)) / 2.0`, the only expression node created
+/// is the one of `z`, with child expression nodes x, y and x.
+template<typename T>
+auto lazy(const Variable<T>& x) { return LazyVariable<T>(x.expr.get()); }
 
-    auto operator! () const { return BooleanExpr([=]() { return !(expr()); }); }
-};
+template<typename T>
+void lazy(const Variable<T>&& x) = delete; // the compile-time expression would refer to a destroyed variable
 
-/// Capture numeric comparison between two expression trees
-template<typename T, typename Comparator>
-auto expr_comparison(const ExprPtr<T>& l, const ExprPtr<T>& r, Comparator&& compare) {
-    return BooleanExpr([=]() mutable -> bool {
-        l->update();
-        r->update();
-        return compare(l->val, r->val);
-    });
+/// Return an argument of an operation with a compile-time expression as a compile-time expression.
+template<typename T, typename X>
+auto lazify(const X& x)
+{
+    if constexpr(isLazyExpr<X>) return x;
+    else if constexpr(isVariable<X>) return lazy(x);
+    else return LazyConstant<T>{ T(x) };
 }
 
-template<typename Op> auto bool_expr_op(BooleanExpr& l, BooleanExpr& r, Op op) {
-    return BooleanExpr([=]() mutable -> bool {
-        l.update();
-        r.update();
-        return op(l, r);
-    });
-}
+/// A compile-time constant that indicates whether the arguments of a binary operation make a compile-time expression.
+template<typename L, typename R>
+constexpr bool isLazyOperands = (isLazyExpr<L> && (isLazyExpr<R> || isVariable<R> || isArithmetic<R>)) || (isLazyExpr<R> && (isVariable<L> || isArithmetic<L>));
 
-inline auto operator && (BooleanExpr&& l, BooleanExpr&& r) { return bool_expr_op(l, r, std::logical_and<> {}); }
-inline auto operator || (BooleanExpr&& l, BooleanExpr&& r) { return bool_expr_op(l, r, std::logical_or<> {}); }
+/// The value type of the compile-time expression among the arguments of a binary operation.
+template<typename L, typename R>
+using LazyValueType = typename PlainType<std::conditional_t<isLazyExpr<L>, L, R>>::ValueType;
 
-/// Select between expression branches depending on a boolean expression
-template<typename T>
-struct ConditionalExpr : Expr<T>
+template<typename Op, typename L, typename R>
+auto lazy_binary(const L& l, const R& r)
 {
-    // Using declarations for data members of base class
-    BooleanExpr predicate;
-    using Expr<T>::val;
-    ExprPtr<T> l, r;
+    using T = LazyValueType<L, R>;
+    using A = decltype(lazify<T>(l));
+    using B = decltype(lazify<T>(r));
+    return LazyBinaryExpr<Op, A, B>(lazify<T>(l), lazify<T>(r));
+}
 
-    ConditionalExpr(const BooleanExpr& wrappedPred, const ExprPtr<T>& ll, const ExprPtr<T>& rr) : Expr<T>(wrappedPred ? ll->val : rr->val), predicate(wrappedPred), l(ll), r(rr) {}
+template<typename E, Requires<isLazyExpr<E>> = true> auto operator-(const E& e) { return LazyUnaryExpr<NegOp, E>(e); }
+
+template<typename L, typename R, Requires<isLazyOperands<L, R>> = true> auto operator+(const L& l, const R& r) { return lazy_binary<AddOp>(l, r); }
+template<typename L, typename R, Requires<isLazyOperands<L, R>> = true> auto operator-(const L& l, const R& r) { return lazy_binary<SubOp>(l, r); }
+template<typename L, typename R, Requires<isLazyOperands<L, R>> = true> auto operator*(const L& l, const R& r) { return lazy_binary<MulOp>(l, r); }
+template<typename L, typename R, Requires<isLazyOperands<L, R>> = true> auto operator/(const L& l, const R& r) { return lazy_binary<DivOp>(l, r); }
+
+template<typename E, Requires<isLazyExpr<E>> = true> auto sin(const E& e) { return LazyUnaryExpr<SinOp, E>(e); }
+template<typename E, Requires<isLazyExpr<E>> = true> auto cos(const E& e) { return LazyUnaryExpr<CosOp, E>(e); }
+template<typename E, Requires<isLazyExpr<E>> = true> auto tan(const E& e) { return LazyUnaryExpr<TanOp, E>(e); }
+template<typename E, Requires<isLazyExpr<E>> = true> auto tanh(const E& e) { return LazyUnaryExpr<TanhOp, E>(e); }
+template<typename E, Requires<isLazyExpr<E>> = true> auto exp(const E& e) { return LazyUnaryExpr<ExpOp, E>(e); }
+template<typename E, Requires<isLazyExpr<E>> = true> auto log(const E& e) { return LazyUnaryExpr<LogOp, E>(e); }
+template<typename E, Requires<isLazyExpr<E>> = true> auto sqrt(const E& e) { return LazyUnaryExpr<SqrtOp, E>(e); }
+
+/// The recording mode in which each statement assigned to a variable is collapsed into a single expression node (statement-level preaccumulation).
+/// While a Preaccumulation object is alive (in the thread it was created), the
+/// expression tree assigned to a Variable object is swept in reverse once, down to
+/// the variables it depends on, and replaced by a @ref PreaccumulatedExpr node with
+/// these variables as child expression nodes. The intermediate expression nodes of
+/// the statement are then released, so that the memory used by a computation grows
+/// with its number of statements instead of its number of operations. Only
+/// first-order derivatives of preaccumulated statements are supported, and they
+/// cannot be updated for new values of their inputs (which throws a std::logic_error,
+/// as does recording a tape to be replayed with such statements, see @ref ReplayTape).
+struct Preaccumulation
+{
+    /// The flag that indicates whether the mode was active before this object was created.
+    bool previous;
 
-    void propagate(const T& wprime) override
+    /// Construct a Preaccumulation object and activate the mode.
+    Preaccumulation() : previous(active())
     {
-        if(predicate.val) l->propagate(wprime);
-        else r->propagate(wprime);
+        active() = true;
     }
 
-    void propagatex(const ExprPtr<T>& wprime) override
-    {
-        l->propagatex(derive(wprime, constant<T>(0.0)));
-        r->propagatex(derive(constant<T>(0.0), wprime));
-    }
+    Preaccumulation(const Preaccumulation&) = delete;
+
+    Preaccumulation& operator=(const Preaccumulation&) = delete;
 
-    void update() override
+    /// Destroy this Preaccumulation object, restoring the previous mode.
+    ~Preaccumulation()
     {
-        predicate.update();
-        if(predicate.val) {
-            l->update();
-            this->val = l->val;
-        } else {
-            r->update();
-            this->val = r->val;
-        }
+        active() = previous;
     }
 
-    ExprPtr<T> derive(const ExprPtr<T>& left, const ExprPtr<T>& right) const {
-      return std::make_shared<ConditionalExpr>(predicate, left, right);
+    /// Return the flag that indicates whether the mode is active in the current thread.
+    static bool& active()
+    {
+        static thread_local bool flag = false;
+        return flag;
     }
 };
 
-//------------------------------------------------------------------------------
-// CONVENIENT FUNCTIONS
-//------------------------------------------------------------------------------
-
-//------------------------------------------------------------------------------
-// ARITHMETIC OPERATORS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> operator+(const ExprPtr<T>& r) { return r; }
-template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& r) { return std::make_shared<NegativeExpr<T>>(-r->val, r); }
-
-template<typename T> ExprPtr<T> operator+(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<AddExpr<T>>(l->val + r->val, l, r); }
-template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<SubExpr<T>>(l->val - r->val, l, r); }
-template<typename T> ExprPtr<T> operator*(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<MulExpr<T>>(l->val * r->val, l, r); }
-template<typename T> ExprPtr<T> operator/(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<DivExpr<T>>(l->val / r->val, l, r); }
-
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator+(const U& l, const ExprPtr<T>& r) { return constant<T>(l) + r; }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator-(const U& l, const ExprPtr<T>& r) { return constant<T>(l) - r; }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator*(const U& l, const ExprPtr<T>& r) { return constant<T>(l) * r; }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator/(const U& l, const ExprPtr<T>& r) { return constant<T>(l) / r; }
-
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator+(const ExprPtr<T>& l, const U& r) { return l + constant<T>(r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator-(const ExprPtr<T>& l, const U& r) { return l - constant<T>(r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator*(const ExprPtr<T>& l, const U& r) { return l * constant<T>(r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> operator/(const ExprPtr<T>& l, const U& r) { return l / constant<T>(r); }
-
-//------------------------------------------------------------------------------
-// TRIGONOMETRIC FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> sin(const ExprPtr<T>& x) { return std::make_shared<SinExpr<T>>(sin(x->val), x); }
-template<typename T> ExprPtr<T> cos(const ExprPtr<T>& x) { return std::make_shared<CosExpr<T>>(cos(x->val), x); }
-template<typename T> ExprPtr<T> tan(const ExprPtr<T>& x) { return std::make_shared<TanExpr<T>>(tan(x->val), x); }
-template<typename T> ExprPtr<T> asin(const ExprPtr<T>& x) { return std::make_shared<ArcSinExpr<T>>(asin(x->val), x); }
-template<typename T> ExprPtr<T> acos(const ExprPtr<T>& x) { return std::make_shared<ArcCosExpr<T>>(acos(x->val), x); }
-template<typename T> ExprPtr<T> atan(const ExprPtr<T>& x) { return std::make_shared<ArcTanExpr<T>>(atan(x->val), x); }
-template<typename T> ExprPtr<T> atan2(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<ArcTan2Expr<T>>(atan2(l->val, r->val), l, r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> atan2(const U& l, const ExprPtr<T>& r) { return std::make_shared<ArcTan2Expr<T>>(atan2(l, r->val), constant<T>(l), r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> atan2(const ExprPtr<T>& l, const U& r) { return std::make_shared<ArcTan2Expr<T>>(atan2(l->val, r), l, constant<T>(r)); }
-
-
-//------------------------------------------------------------------------------
-// HYPOT2 FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> hypot(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<Hypot2Expr<T>>(hypot(l->val, r->val), l, r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const U& l, const ExprPtr<T>& r) { return std::make_shared<Hypot2Expr<T>>(hypot(l, r->val), constant<T>(l), r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l, const U& r) { return std::make_shared<Hypot2Expr<T>>(hypot(l->val, r), l, constant<T>(r)); }
-
-//------------------------------------------------------------------------------
-// HYPOT3 FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> hypot(const ExprPtr<T>& l, const ExprPtr<T>& c, const ExprPtr<T>& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l->val,c->val, r->val), l, c, r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l, const ExprPtr<T>& c, const U& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l->val, c->val, r), l, c, constant<T>(r)); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const U& l, const ExprPtr<T>& c, const ExprPtr<T>& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l, c->val, r->val), constant<T>(l), c, r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l,const U& c, const ExprPtr<T>& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l->val, c, r->val), l, constant<T>(c), r); }
-template<typename T, typename U, typename V, Requires<isArithmetic<U> && isArithmetic<V>> = true> ExprPtr<T> hypot(const ExprPtr<T>& l, const U& c, const V& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l->val, c, r), l, constant<T>(c), constant<T>(r)); }
-template<typename T, typename U, typename V, Requires<isArithmetic<U> && isArithmetic<V>> = true> ExprPtr<T> hypot(const U& l, const ExprPtr<T>& c, const V& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l, c->val, r), constant<T>(l), c, constant<T>(r)); }
-template<typename T, typename U, typename V, Requires<isArithmetic<U> && isArithmetic<V>> = true> ExprPtr<T> hypot(const V& l, const U& c, const ExprPtr<T>& r) { return std::make_shared<Hypot3Expr<T>>(hypot(l, c, r->val), constant<T>(l), constant<T>(c), r); }
-
-//------------------------------------------------------------------------------
-// HYPERBOLIC FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> sinh(const ExprPtr<T>& x) { return std::make_shared<SinhExpr<T>>(sinh(x->val), x); }
-template<typename T> ExprPtr<T> cosh(const ExprPtr<T>& x) { return std::make_shared<CoshExpr<T>>(cosh(x->val), x); }
-template<typename T> ExprPtr<T> tanh(const ExprPtr<T>& x) { return std::make_shared<TanhExpr<T>>(tanh(x->val), x); }
+/// Return the expression tree of a statement collapsed into a @ref PreaccumulatedExpr node if @ref Preaccumulation is active, or else the expression tree itself.
+/// The expression tree is returned unchanged if it is a variable or a constant,
+/// if it contains expression nodes with several outputs, or if T is not arithmetic.
+template<typename T>
+auto preaccumulate(const ExprPtr<T>& e) -> ExprPtr<T>
+{
+    if constexpr(!isArithmetic<T>)
+        return e;
+    else
+    {
+        if(!Preaccumulation::active() || e->arity() == 0 || dynamic_cast<VariableExpr<T>*>(e.get()))
+            return e;
+
+        static thread_local std::vector<Expr<T>*> nodes;
+        static thread_local std::vector<std::size_t> previous;
+        static thread_local std::vector<std::pair<Expr<T>*, bool>> stack;
+        static thread_local std::vector<T> adjoints;
+        static thread_local std::vector<T> d;
+
+        // The inputs of the statement are the variables and the other expression nodes without child expression nodes
+        auto input = [&](Expr<T>* x) { return x != e.get() && (x->arity() == 0 || dynamic_cast<VariableExpr<T>*>(x)); };
+        auto contains = [&](const Expr<T>* x) { return x->index < nodes.size() && nodes[x->index] == x; };
+
+        nodes.clear();
+        previous.clear();
+        stack.assign(1, { e.get(), false });
+
+        bool supported = true;
+
+        while(!stack.empty()) // the expression nodes of the statement in topological order, as in Tape::record
+        {
+            const auto [x, visited] = stack.back();
+            stack.pop_back();
+
+            if(contains(x))
+                continue;
+
+            if(visited || input(x))
+            {
+                supported = supported && !x->multioutput();
+                previous.push_back(x->index);
+                x->index = nodes.size();
+                nodes.push_back(x);
+                continue;
+            }
+
+            stack.emplace_back(x, true);
+
+            for(auto i = x->arity(); i > 0; --i)
+                if(!contains(x->operand(i - 1)))
+                    stack.emplace_back(x->operand(i - 1), false);
+        }
 
-//------------------------------------------------------------------------------
-// EXPONENTIAL AND LOGARITHMIC FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> exp(const ExprPtr<T>& x) { return std::make_shared<ExpExpr<T>>(exp(x->val), x); }
-template<typename T> ExprPtr<T> log(const ExprPtr<T>& x) { return std::make_shared<LogExpr<T>>(log(x->val), x); }
-template<typename T> ExprPtr<T> log10(const ExprPtr<T>& x) { return std::make_shared<Log10Expr<T>>(log10(x->val), x); }
+        const auto n = nodes.size();
+
+        std::vector<ExprPtr<T>> inputs;
+        std::vector<T> weights;
+
+        if(supported)
+        {
+            adjoints.assign(n, T(0.0));
+            adjoints[n - 1] = 1.0;
+
+            for(auto i = n; i > 0; --i)
+            {
+                auto* x = nodes[i - 1];
+                const T w = adjoints[i - 1];
+                if(input(x) || w == 0.0)
+                    continue;
+                d.resize(x->arity());
+                x->partials(d.data());
+                for(auto k = 0U; k < d.size(); ++k)
+                    adjoints[x->operand(k)->index] += w * d[k];
+            }
+
+            for(auto i = 0U; i < n; ++i) // inputs with zero derivatives are kept, as their second-order derivatives may not be zero
+            {
+                if(input(nodes[i]) && !nodes[i]->isconstant())
+                {
+                    inputs.emplace_back(nodes[i]);
+                    weights.push_back(adjoints[i]);
+                }
+            }
+        }
 
-//------------------------------------------------------------------------------
-// POWER FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> sqrt(const ExprPtr<T>& x) { return std::make_shared<SqrtExpr<T>>(sqrt(x->val), x); }
-template<typename T> ExprPtr<T> pow(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<PowExpr<T>>(pow(l->val, r->val), l, r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> pow(const U& l, const ExprPtr<T>& r) { return std::make_shared<PowConstantLeftExpr<T>>(pow(l, r->val), constant<T>(l), r); }
-template<typename T, typename U, Requires<isArithmetic<U>> = true> ExprPtr<T> pow(const ExprPtr<T>& l, const U& r) { return std::make_shared<PowConstantRightExpr<T>>(pow(l->val, r), l, constant<T>(r)); }
+        for(auto i = n; i > 0; --i)
+            nodes[i - 1]->index = previous[i - 1];
 
-//------------------------------------------------------------------------------
-// OTHER FUNCTIONS
-//------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> abs(const ExprPtr<T>& x) { return std::make_shared<AbsExpr<T>>(abs(x->val), x); }
-template<typename T> ExprPtr<T> abs2(const ExprPtr<T>& x) { return x * x; }
-template<typename T> ExprPtr<T> conj(const ExprPtr<T>& x) { return x; }
-template<typename T> ExprPtr<T> real(const ExprPtr<T>& x) { return x; }
-template<typename T> ExprPtr<T> imag(const ExprPtr<T>&) { return constant<T>(0.0); }
-template<typename T> ExprPtr<T> erf(const ExprPtr<T>& x) { return std::make_shared<ErfExpr<T>>(erf(x->val), x); }
+        if(!supported)
+            return e;
+        if(inputs.empty())
+            return constant<T>(e->val);
+        return make_expr<PreaccumulatedExpr<T>>(e->val, std::move(inputs), std::move(weights));
+    }
+}
 
 /// The autodiff variable type used for detail mode automatic differentiation.
 template<typename T>
@@ -1198,10 +3713,14 @@ struct Variable
 
     /// Construct a Variable object with given arithmetic value
     template<typename U, Requires<isArithmetic<U>> = true>
-    Variable(const U& val) : expr(std::make_shared<IndependentVariableExpr<T>>(val)) {}
+    Variable(const U& val) : expr(make_expr<IndependentVariableExpr<T>>(val)) {}
 
     /// Construct a Variable object with given expression
-    Variable(const ExprPtr<T>& e) : expr(std::make_shared<DependentVariableExpr<T>>(e)) {}
+    Variable(const ExprPtr<T>& e) : expr(make_expr<DependentVariableExpr<T>>(preaccumulate(e))) {}
+
+    /// Construct a Variable object with given compile-time expression, in a single expression node (see @ref lazy).
+    template<typename E, Requires<isLazyExpr<E>> = true>
+    Variable(const E& e) : Variable(statement(e)) { static_assert(isSame<typename E::ValueType, T>, "The compile-time expression has another value type."); }
 
     /// Default copy assignment
     Variable& operator=(const Variable&) = default;
@@ -1210,9 +3729,8 @@ struct Variable
     void update() { expr->update(); }
 
     void update(T value) {
-      if(auto independentExpr = std::dynamic_pointer_cast<IndependentVariableExpr<T>>(expr)) {
+      if(auto independentExpr = dynamic_cast<IndependentVariableExpr<T>*>(expr.get())) {
         independentExpr->val = value;
-        independentExpr->update();
       } else {
         throw std::logic_error("Cannot update the value of a dependent expression stored in a variable");
       }
@@ -1229,7 +3747,19 @@ struct Variable
     auto operator=(const ExprPtr<T>& x) -> Variable& { *this = Variable(x); return *this; }
 
     // Assignment operators
-    Variable& operator+=(const ExprPtr<T>& x) { *this = Variable(expr + x); return *this; }
+    Variable& operator+=(const ExprPtr<T>& x)
+    {
+        // Append x to the sum expression of this variable if no other expression shares it (e.g., in loops such as `s += x[i]`),
+        // instead of creating a chain of AddExpr nodes, each with its own DependentVariableExpr node
+        if(auto* sum = appendable_sum(); sum && x != expr)
+        {
+            sum->append(x);
+            expr->val = sum->val;
+            return *this;
+        }
+        *this = Variable(make_expr<SumExpr<T>>(std::vector<ExprPtr<T>>{ expr, x }));
+        return *this;
+    }
     Variable& operator-=(const ExprPtr<T>& x) { *this = Variable(expr - x); return *this; }
     Variable& operator*=(const ExprPtr<T>& x) { *this = Variable(expr * x); return *this; }
     Variable& operator/=(const ExprPtr<T>& x) { *this = Variable(expr / x); return *this; }
@@ -1240,6 +3770,17 @@ struct Variable
     template<typename U, Requires<isArithmetic<U>> = true> Variable& operator*=(const U& x) { *this = Variable(expr * x); return *this; }
     template<typename U, Requires<isArithmetic<U>> = true> Variable& operator/=(const U& x) { *this = Variable(expr / x); return *this; }
 
+    /// Return the sum expression defining this variable if it can be extended in place (i.e., if neither this variable's expression nor its sum expression is shared).
+    SumExpr<T>* appendable_sum() const
+    {
+        if(expr.use_count() != 1)
+            return nullptr;
+        auto* dependent = dynamic_cast<DependentVariableExpr<T>*>(expr.get());
+        if(!dependent || dependent->expr.use_count() != 1)
+            return nullptr;
+        return dynamic_cast<SumExpr<T>*>(dependent->expr.get());
+    }
+
 #if defined(AUTODIFF_ENABLE_IMPLICIT_CONVERSION_VAR) || defined(AUTODIFF_ENABLE_IMPLICIT_CONVERSION)
     operator T() const { return expr->val; }
 
@@ -1282,24 +3823,24 @@ template<typename T, typename U> constexpr bool is_binary_expr_v = is_binary_exp
 // COMPARISON OPERATORS
 //------------------------------------------------------------------------------
 
-template<typename Comparator, typename T, typename U>
-auto comparison_operator(const T& t, const U& u) {
+template<typename T, typename U>
+auto comparison_operator(Comparison op, const T& t, const U& u) {
     using C = expr_common_t<T, U>;
-    return expr_comparison(coerce_expr<C>(t), coerce_expr<C>(u), Comparator {});
+    return ComparisonExpr<C>(op, coerce_expr<C>(t), coerce_expr<C>(u));
 }
 
 template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
-auto operator == (const T& t, const U& u) { return comparison_operator<std::equal_to<>>(t, u); }
+auto operator == (const T& t, const U& u) { return comparison_operator(Comparison::Equal, t, u); }
 template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
-auto operator != (const T& t, const U& u) { return comparison_operator<std::not_equal_to<>>(t, u); }
+auto operator != (const T& t, const U& u) { return comparison_operator(Comparison::NotEqual, t, u); }
 template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
-auto operator <= (const T& t, const U& u) { return comparison_operator<std::less_equal<>>(t, u); }
+auto operator <= (const T& t, const U& u) { return comparison_operator(Comparison::LessEqual, t, u); }
 template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
-auto operator >= (const T& t, const U& u) { return comparison_operator<std::greater_equal<>>(t, u); }
+auto operator >= (const T& t, const U& u) { return comparison_operator(Comparison::GreaterEqual, t, u); }
 template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
-auto operator < (const T& t, const U& u) { return comparison_operator<std::less<>>(t, u); }
+auto operator < (const T& t, const U& u) { return comparison_operator(Comparison::Less, t, u); }
 template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
-auto operator > (const T& t, const U& u) { return comparison_operator<std::greater<>>(t, u); }
+auto operator > (const T& t, const U& u) { return comparison_operator(Comparison::Greater, t, u); }
 
 //------------------------------------------------------------------------------
 // CONDITION AND RELATED FUNCTIONS
@@ -1308,14 +3849,35 @@ auto operator > (const T& t, const U& u) { return comparison_operator<std::great
 template<typename T, typename U, Requires<is_expr_v<T> && is_expr_v<U>> = true>
 auto condition(BooleanExpr&& p, const T& t, const U& u) {
   using C = expr_common_t<T, U>;
-  ExprPtr<C> expr = std::make_shared<ConditionalExpr<C>>(std::forward<BooleanExpr>(p), coerce_expr<C>(t), coerce_expr<C>(u));
+  ExprPtr<C> expr = make_expr<ConditionalExpr<C>>(std::forward<BooleanExpr>(p), coerce_expr<C>(t), coerce_expr<C>(u));
   return expr;
 }
 
-template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true> auto min(const T& x, const U& y) { return condition(x < y, x, y); }
-template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true> auto max(const T& x, const U& y) { return condition(x > y, x, y); }
-template<typename T> ExprPtr<T> sgn(const ExprPtr<T>& x) { return condition(x < 0, -1.0, condition(x > 0, 1.0, 0.0)); }
-template<typename T> ExprPtr<T> sgn(const Variable<T>& x) { return condition(x.expr < 0, -1.0, condition(x.expr > 0, 1.0, 0.0)); }
+/// Select between two expressions depending on a comparison between two others, in a single @ref SelectExpr node.
+template<typename P, typename T, typename U, Requires<is_expr_v<T> && is_expr_v<U>> = true>
+auto condition(const ComparisonExpr<P>& p, const T& t, const U& u) {
+  static_assert(isSame<P, expr_common_t<T, U>>, "The compared expressions and the selected ones have different value types.");
+  return select(p.op, p.l, p.r, coerce_expr<P>(t), coerce_expr<P>(u));
+}
+
+template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
+auto min(const T& x, const U& y) {
+  using C = expr_common_t<T, U>;
+  const auto l = coerce_expr<C>(x);
+  const auto r = coerce_expr<C>(y);
+  return make_folded_expr<MinExpr<C>>(l->val < r->val ? l->val : r->val, l, r);
+}
+
+template<typename T, typename U, Requires<is_binary_expr_v<T, U>> = true>
+auto max(const T& x, const U& y) {
+  using C = expr_common_t<T, U>;
+  const auto l = coerce_expr<C>(x);
+  const auto r = coerce_expr<C>(y);
+  return make_folded_expr<MaxExpr<C>>(l->val > r->val ? l->val : r->val, l, r);
+}
+
+template<typename T> ExprPtr<T> sgn(const ExprPtr<T>& x) { return make_folded_expr<SgnExpr<T>>(SgnExpr<T>::sign(x->val), x); }
+template<typename T> ExprPtr<T> sgn(const Variable<T>& x) { return sgn(x.expr); }
 
 //------------------------------------------------------------------------------
 // ARITHMETIC OPERATORS (DEFINED FOR ARGUMENTS OF TYPE Variable)
@@ -1443,22 +4005,31 @@ auto wrt(Args&&... args)
     return Wrt<Args&&...>{ std::forward_as_tuple(std::forward<Args>(args)...) };
 }
 
+/// Return the expression nodes of the variables in a @ref Wrt object.
+template<typename T, typename... Vars>
+auto wrtnodes(const Wrt<Vars...>& wrt)
+{
+    constexpr auto N = sizeof...(Vars);
+    std::array<const Expr<T>*, N> nodes;
+    For<N>([&](auto i) constexpr {
+        nodes[i] = std::get<i>(wrt.args).expr.get();
+    });
+    return nodes;
+}
+
 /// Return the derivatives of a dependent variable y with respect given independent variables.
 template<typename T, typename... Vars>
 auto derivatives(const Variable<T>& y, const Wrt<Vars...>& wrt)
 {
     constexpr auto N = sizeof...(Vars);
     std::array<T, N> values;
-    values.fill(0.0);
-
-    For<N>([&](auto i) constexpr {
-        std::get<i>(wrt.args).expr->bind_value(&values.at(i));
-    });
 
-    y.expr->propagate(1.0);
+    Tape<T> tape(y.expr.get());
+    tape.activate(wrtnodes<T>(wrt).data(), N);
+    tape.propagate(1.0);
 
     For<N>([&](auto i) constexpr {
-        std::get<i>(wrt.args).expr->bind_value(nullptr);
+        values.at(i) = tape.adjoint(std::get<i>(wrt.args).expr.get());
     });
 
     return values;
@@ -1471,19 +4042,116 @@ auto derivativesx(const Variable<T>& y, const Wrt<Vars...>& wrt)
     constexpr auto N = sizeof...(Vars);
     std::array<Variable<T>, N> values;
 
+    Tape<T> tape(y.expr.get());
+    tape.activate(wrtnodes<T>(wrt).data(), N);
+    tape.propagatex(constant<T>(1.0));
+
     For<N>([&](auto i) constexpr {
-        std::get<i>(wrt.args).expr->bind_expr(&values.at(i).expr);
+        values.at(i).expr = tape.adjointx(std::get<i>(wrt.args).expr.get());
     });
 
-    y.expr->propagatex(constant<T>(1.0));
+    return values;
+}
+
+/// Return the tape reused in the current thread by the reverse sweeps that write into caller buffers.
+/// Its buffers keep their capacity from one sweep to the next, so that sweeps
+/// over expression trees no larger than those swept before allocate no memory.
+template<typename T>
+auto scratch_tape() -> Tape<T>&
+{
+    static thread_local Tape<T> tape;
+    return tape;
+}
+
+/// Add the derivatives of a dependent variable y with respect to given independent variables to a caller buffer, without allocating memory.
+/// @param y The dependent variable.
+/// @param wrt The independent variables.
+/// @param grad The array of size `sizeof...(Vars)` where the derivatives are accumulated.
+template<typename T, typename... Vars>
+void derivatives(const Variable<T>& y, const Wrt<Vars...>& wrt, T* grad)
+{
+    constexpr auto N = sizeof...(Vars);
+
+    auto& tape = scratch_tape<T>();
+    tape.record(y.expr.get());
+    tape.activate(wrtnodes<T>(wrt).data(), N);
+    tape.propagate(1.0);
 
     For<N>([&](auto i) constexpr {
-        std::get<i>(wrt.args).expr->bind_expr(nullptr);
+        grad[i] += tape.adjoint(std::get<i>(wrt.args).expr.get());
     });
-
-    return values;
 }
 
+/// The independent variables of repeated derivative computations, bound once to the positions of their derivatives in caller buffers.
+/// The tape of the context is reused in every reverse sweep, so that, once it
+/// has grown to the size of the expression trees being swept (e.g., after the
+/// first iteration of a control loop), computing derivatives allocates no memory.
+template<typename T>
+struct GradientContext
+{
+    /// The expression nodes of the independent variables, in the order of their derivatives (kept alive by the context).
+    std::vector<ExprPtr<T>> inputs;
+
+    /// The expression nodes of the independent variables, those the reverse sweeps are restricted to (see Tape::activate).
+    std::vector<const Expr<T>*> nodes;
+
+    /// The tape reused in every reverse sweep.
+    Tape<T> tape;
+
+    /// Construct a default GradientContext object, without independent variables.
+    GradientContext() = default;
+
+    /// Construct a GradientContext object with given independent variables (e.g., `wrt(x, y)` or a vector of variables).
+    template<typename X, Requires<!isSame<X, GradientContext>> = true>
+    explicit GradientContext(const X& x) { bind(x); }
+
+    /// Bind the independent variables in a @ref Wrt object to the positions 0, 1, ... of the derivatives.
+    template<typename... Vars>
+    void bind(const Wrt<Vars...>& wrt)
+    {
+        constexpr auto N = sizeof...(Vars);
+        inputs.resize(N);
+        For<N>([&](auto i) constexpr {
+            inputs[i] = std::get<i>(wrt.args).expr;
+        });
+        rebind();
+    }
+
+    /// Bind the independent variables in a vector of variables (with `size()` and `operator[]`) to the positions 0, 1, ... of the derivatives.
+    template<typename X>
+    void bind(const X& x)
+    {
+        const auto n = static_cast<std::size_t>(x.size());
+        inputs.resize(n);
+        for(auto i = 0U; i < n; ++i)
+            inputs[i] = x[i].expr;
+        rebind();
+    }
+
+    /// Return the number of independent variables.
+    auto size() const { return inputs.size(); }
+
+    /// Add the derivatives of a dependent variable y with respect to the independent variables to a caller buffer.
+    /// @param y The dependent variable.
+    /// @param grad The array of size @ref size where the derivatives are accumulated.
+    void accumulate(const Variable<T>& y, T* grad)
+    {
+        tape.record(y.expr.get());
+        tape.activate(nodes.data(), nodes.size());
+        tape.propagate(1.0);
+        for(auto i = 0U; i < nodes.size(); ++i)
+            grad[i] += tape.adjoint(nodes[i]);
+    }
+
+    /// Update the expression nodes the reverse sweeps are restricted to from those in @ref inputs.
+    void rebind()
+    {
+        nodes.resize(inputs.size());
+        for(auto i = 0U; i < inputs.size(); ++i)
+            nodes[i] = inputs[i].get();
+    }
+};
+
 /// Output a Variable object to the output stream.
 template<typename T>
 std::ostream& operator<<(std::ostream& out, const Variable<T>& x)
@@ -1532,6 +4200,12 @@ using reverse::detail::wrt;
 using reverse::detail::derivatives;
 using reverse::detail::Variable;
 using reverse::detail::val;
+using reverse::detail::ExprArena;
+using reverse::detail::ExprCache;
+using reverse::detail::external;
+using reverse::detail::GradientContext;
+using reverse::detail::Preaccumulation;
+using reverse::detail::lazy;
 
 using var = Variable<double>;
 
@@ -0,0 +1,89 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright © 2018–2024 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Eigen includes
+#include <Eigen/Geometry>
+
+// autodiff includes
+#include <autodiff/reverse/svar.hpp>
+#include <autodiff/reverse/svar/eigen.hpp>
+#include <autodiff/reverse/var.hpp>
+#include <autodiff/reverse/var/eigen.hpp>
+#include <tests/utils/catch.hpp>
+
+using autodiff::gradient;
+using autodiff::StaticTape;
+using autodiff::svar;
+using autodiff::val;
+using autodiff::var;
+using autodiff::variables;
+using autodiff::Vector3svar;
+using autodiff::Vector3var;
+
+using Eigen::Vector3d;
+
+/// The area of the triangle with given vertices (a small geometry kernel).
+template<typename Vector3>
+auto area(const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    return 0.5 * (b - a).cross(c - a).norm();
+}
+
+TEST_CASE("testing autodiff::svar (with eigen)", "[reverse][svar][eigen]")
+{
+    const Vector3d a(0.0, 0.0, 0.0), b(1.0, 0.2, 0.1), c(0.3, 2.0, 0.5);
+
+    // The gradient of the area w.r.t. the first vertex with var objects
+    Vector3var av = a, bv = b, cv = c;
+    var yv = area(av, bv, cv);
+    Vector3d gv = gradient(yv, av);
+
+    // The same gradient with svar objects recorded in a tape on the stack
+    StaticTape<double, 256> tape;
+    for(auto k = 0; k < 2; ++k) // the tape is reused for each evaluation of the kernel
+    {
+        tape.clear();
+        Vector3svar as = variables(tape, a);
+        Vector3svar bs = variables(tape, b);
+        Vector3svar cs = variables(tape, c);
+        svar ys = area(as, bs, cs);
+        Vector3d gs = gradient(ys, as);
+
+        CHECK( val(ys) == approx(yv) );
+        CHECK( gs[0] == approx(gv[0]) );
+        CHECK( gs[1] == approx(gv[1]) );
+        CHECK( gs[2] == approx(gv[2]) );
+
+        CHECK( gradient(ys, bs).isApprox(gradient(yv, bv)) );
+    }
+
+    // Static variables of constants (not recorded in the tape) have zero gradients
+    Vector3svar xs = a.cast<svar>();
+    CHECK( gradient(xs.squaredNorm(), xs).isZero() );
+}
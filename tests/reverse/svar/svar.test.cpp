@@ -0,0 +1,138 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright © 2018–2024 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// C++ includes
+#include <stdexcept>
+#include <type_traits>
+
+// autodiff includes
+#include <autodiff/reverse/svar.hpp>
+#include <tests/utils/catch.hpp>
+
+using autodiff::StaticTape;
+using autodiff::svar;
+using autodiff::val;
+
+/// Convenient function used in the tests to calculate the derivative of a static variable y with respect to a static variable x.
+inline auto grad(const svar& y, const svar& x)
+{
+    y.tape->propagate(y);
+    return y.tape->adjoint(x);
+}
+
+TEST_CASE("testing autodiff::svar", "[reverse][svar]")
+{
+    static_assert(std::is_trivially_copyable_v<svar>);
+
+    StaticTape<double, 64> tape;
+
+    svar x = tape.variable(0.5);
+    svar y = tape.variable(2.0);
+
+    //--------------------------------------------------------------------------
+    // TEST ARITHMETIC OPERATORS
+    //--------------------------------------------------------------------------
+    svar r = x * y + x / y - 3.0 * x + 1.0 / y - (-x);
+    REQUIRE( val(r) == approx(1.0 + 0.25 - 1.5 + 0.5 + 0.5) );
+    REQUIRE( grad(r, x) == approx(2.0 + 0.5 - 3.0 + 1.0) );
+    REQUIRE( grad(r, y) == approx(0.5 - 0.125 - 0.25) );
+
+    r = x;
+    r *= y;
+    r += 2.0;
+    r /= x;
+    r -= y;
+    REQUIRE( val(r) == approx(2.0 + 2.0 / 0.5 - 2.0) );
+    REQUIRE( grad(r, x) == approx(-2.0 / 0.25) );
+    REQUIRE( grad(r, y) == approx(0.0) );
+
+    //--------------------------------------------------------------------------
+    // TEST COMPARISON OPERATORS AND CONSTANTS
+    //--------------------------------------------------------------------------
+    REQUIRE( x < y );
+    REQUIRE( x == 0.5 );
+    REQUIRE( 2.0 >= y );
+    REQUIRE( x != y );
+
+    svar c = 3.0; // a constant is not recorded in any tape
+    REQUIRE( c.tape == nullptr );
+    REQUIRE( (c * c).tape == nullptr );
+    REQUIRE( grad(c * x, x) == approx(3.0) );
+    REQUIRE( grad(x, y) == approx(0.0) );
+
+    //--------------------------------------------------------------------------
+    // TEST MATHEMATICAL FUNCTIONS
+    //--------------------------------------------------------------------------
+    REQUIRE( grad(sin(x), x) == approx(std::cos(0.5)) );
+    REQUIRE( grad(cos(x), x) == approx(-std::sin(0.5)) );
+    REQUIRE( grad(tan(x), x) == approx(1.0 / (std::cos(0.5) * std::cos(0.5))) );
+    REQUIRE( grad(asin(x), x) == approx(1.0 / std::sqrt(0.75)) );
+    REQUIRE( grad(acos(x), x) == approx(-1.0 / std::sqrt(0.75)) );
+    REQUIRE( grad(atan(x), x) == approx(1.0 / 1.25) );
+    REQUIRE( grad(atan2(x, y), x) == approx(2.0 / 4.25) );
+    REQUIRE( grad(atan2(x, y), y) == approx(-0.5 / 4.25) );
+    REQUIRE( grad(hypot(x, y), y) == approx(2.0 / std::hypot(0.5, 2.0)) );
+    REQUIRE( grad(sinh(x), x) == approx(std::cosh(0.5)) );
+    REQUIRE( grad(cosh(x), x) == approx(std::sinh(0.5)) );
+    REQUIRE( grad(tanh(x), x) == approx(1.0 / (std::cosh(0.5) * std::cosh(0.5))) );
+    REQUIRE( grad(exp(x), x) == approx(std::exp(0.5)) );
+    REQUIRE( grad(log(x), x) == approx(2.0) );
+    REQUIRE( grad(log10(x), x) == approx(2.0 / std::log(10.0)) );
+    REQUIRE( grad(sqrt(x), x) == approx(0.5 / std::sqrt(0.5)) );
+    REQUIRE( grad(pow(x, 3.0), x) == approx(0.75) );
+    REQUIRE( grad(pow(2.0, x), x) == approx(std::pow(2.0, 0.5) * std::log(2.0)) );
+    REQUIRE( grad(pow(x, y), x) == approx(1.0) );
+    REQUIRE( grad(pow(x, y), y) == approx(0.25 * std::log(0.5)) );
+    REQUIRE( grad(abs(-x), x) == approx(1.0) );
+    REQUIRE( grad(erf(x), x) == approx(2.0 / std::sqrt(M_PI) * std::exp(-0.25)) );
+    REQUIRE( grad(min(x, y), x) == approx(1.0) );
+    REQUIRE( grad(max(x, y), x) == approx(0.0) );
+
+    //--------------------------------------------------------------------------
+    // TEST REUSE OF THE TAPE AFTER CLEARING IT
+    //--------------------------------------------------------------------------
+    tape.clear();
+    x = tape.variable(1.5);
+    r = x * x * x;
+    REQUIRE( tape.size == 3 );
+    REQUIRE( grad(r, x) == approx(6.75) );
+
+    svar z = x * 2.0; // recorded after the root variable r of the last reverse sweep
+    REQUIRE( tape.adjoint(z) == 0.0 );
+    REQUIRE( grad(x, z) == 0.0 );
+
+    tape.clear();
+    x = tape.variable(1.0);
+    REQUIRE( tape.adjoint(x) == 0.0 ); // no reverse sweep since the tape was cleared
+
+    StaticTape<double, 2> small;
+    svar s = small.variable(1.0);
+    s = s * s;
+    REQUIRE_THROWS_AS( s * s, std::length_error ); // the capacity of the tape is exceeded
+}
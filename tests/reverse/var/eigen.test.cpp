@@ -35,8 +35,21 @@
 #include <autodiff/reverse/var.hpp>
 #include <autodiff/reverse/var/eigen.hpp>
 
+using autodiff::checkpoint;
+using autodiff::cholesky;
+using autodiff::determinant;
+using autodiff::external;
 using autodiff::gradient;
 using autodiff::hessian;
+using autodiff::hessian_vector_product;
+using autodiff::inverse;
+using autodiff::jacobian;
+using autodiff::logdet;
+using autodiff::MatrixXvar;
+using autodiff::record;
+using autodiff::record_batch;
+using autodiff::solve;
+using autodiff::sparse_hessian;
 using autodiff::val;
 using autodiff::var;
 using autodiff::VectorXvar;
@@ -160,4 +173,633 @@ TEST_CASE("testing autodiff::var (with eigen)", "[reverse][var][eigen]")
     CHECK( H(4, 2) == approx( 0.0) );
     CHECK( H(4, 3) == approx(-2.0) );
     CHECK( H(4, 4) == approx( 2.0) );
+
+    //--------------------------------------------------------------------------
+    // TESTING HESSIAN-VECTOR PRODUCTS (FORWARD-OVER-REVERSE)
+    //--------------------------------------------------------------------------
+    x << 0.3, 0.7, 1.2, 2.5, 0.9;
+    y = sin(x[0]) * cos(x[1]) + tan(x[2]) / x[3] + exp(x[4]) * log(x[0]) + pow(x[1], x[2]) + sqrt(x[3])
+      + atan2(x[0], x[1]) + hypot(x[2], x[3]) + hypot(x[0], x[1], x[4]) + asin(x[0] / 10) + acos(x[1] / 10)
+      + atan(x[2]) + sinh(x[3] / 5) + cosh(x[4] / 5) + tanh(x[0]) + erf(x[1] / 5) + log10(x[2])
+      + pow(2.0, x[3]) + pow(x[4], 3.0) + abs(x[0] - x[1]) * x[2] + max(x[3], x[4]) * x[0];
+
+    H = hessian(y, x, g);
+
+    VectorXd w(5);
+    w << 1.0, -2.0, 0.5, 3.0, -1.5;
+    VectorXd Hv = hessian_vector_product(y, x, w);
+    VectorXd Hvexpected = H * w;
+
+    for(auto i = 0; i < x.size(); ++i)
+        CHECK( Hv[i] == approx(Hvexpected[i]) );
+
+    for(auto k = 0; k < x.size(); ++k)
+    {
+        hessian_vector_product(y, x, VectorXd::Unit(5, k), Hv);
+        for(auto i = 0; i < x.size(); ++i)
+            CHECK( Hv[i] == approx(H(i, k)) );
+    }
+
+    {
+        VectorXvar x0(1);
+        x0 << 3.0;
+        VectorXvar a(1);
+        a << 2.0 * x0[0]; // a dependent variable
+        var ya = a[0] * a[0] * a[0];
+
+        VectorXd va(1);
+        va << 1.0;
+        CHECK( hessian(ya, a)(0, 0) == approx(36.0) );
+        CHECK( hessian_vector_product(ya, a, va)[0] == approx(36.0) );
+        CHECK_THROWS_AS( sparse_hessian(ya, a), std::logic_error ); // edge pushing does not stop at dependent variables
+    }
+
+    //--------------------------------------------------------------------------
+    // TESTING SPARSE HESSIAN (EDGE PUSHING)
+    //--------------------------------------------------------------------------
+    Eigen::SparseMatrix<double> Hs = sparse_hessian(y, x);
+    CHECK( MatrixXd(Hs).isApprox(H) );
+
+    y = x[0] * x[0] + x[0] * x[1] + sin(x[2]) * x[2] + x[3] + (x[4] + x[4]) * exp(x[4]);
+    H = hessian(y, x, g);
+    Hs = sparse_hessian(y, x);
+
+    CHECK( Hs.nonZeros() == 5 ); // entries (0, 0), (0, 1), (1, 0), (2, 2), (4, 4)
+    CHECK( MatrixXd(Hs).isApprox(H) );
+
+    //--------------------------------------------------------------------------
+    // TESTING HESSIAN WITH MORE VARIABLES THAN LANES IN A REVERSE SWEEP
+    //--------------------------------------------------------------------------
+    VectorXd zval = VectorXd::LinSpaced(40, 0.1, 4.0);
+    VectorXvar z = zval.cast<var>();
+
+    y = (z.head(39).array() * z.tail(39).array().square()).sum() + z.array().cube().sum();
+    H = hessian(y, z, g);
+
+    for(auto i = 0; i < z.size(); ++i)
+    {
+        CHECK( g[i] == approx((i < 39 ? zval[i + 1] * zval[i + 1] : 0.0) + (i > 0 ? 2.0 * zval[i - 1] * zval[i] : 0.0) + 3.0 * zval[i] * zval[i]) );
+        for(auto j = 0; j < z.size(); ++j)
+        {
+            const auto expected =
+                i == j ? (i > 0 ? 2.0 * zval[i - 1] : 0.0) + 6.0 * zval[i] :
+                j == i + 1 ? 2.0 * zval[j] :
+                i == j + 1 ? 2.0 * zval[i] : 0.0;
+            CHECK( H(i, j) == approx(expected) );
+        }
+    }
+
+    Hs = sparse_hessian(y, z);
+    CHECK( Hs.nonZeros() == 40 + 2 * 39 ); // tridiagonal
+    CHECK( MatrixXd(Hs).isApprox(H) );
+
+    //--------------------------------------------------------------------------
+    // TESTING JACOBIAN OF A VECTOR FUNCTION WITH MORE OUTPUTS THAN LANES
+    //--------------------------------------------------------------------------
+    VectorXvar F = z.array().sin() * z.sum(); // F[i] = sin(z[i]) * sum(z)
+    MatrixXd J;
+    jacobian(F, z, J);
+
+    CHECK( J.rows() == 40 );
+    CHECK( J.cols() == 40 );
+    for(auto i = 0; i < z.size(); ++i)
+        for(auto j = 0; j < z.size(); ++j)
+            CHECK( J(i, j) == approx(std::sin(zval[i]) + (i == j ? std::cos(zval[i]) * zval.sum() : 0.0)) );
+
+    F = x.head(3) * x[4]; // fewer outputs than variables
+    J = jacobian(F, x);
+
+    CHECK( J.rows() == 3 );
+    CHECK( J.cols() == 5 );
+    for(auto i = 0; i < 3; ++i)
+        for(auto j = 0; j < 5; ++j)
+            CHECK( J(i, j) == approx(i == j ? val(x[4]) : j == 4 ? val(x[i]) : 0.0) );
+
+    //--------------------------------------------------------------------------
+    // TESTING GRADIENT THROUGH A CHECKPOINTED REGION WITH MANY STEPS
+    //--------------------------------------------------------------------------
+    const double dt = 0.001;
+    const std::size_t nsteps = 1000;
+
+    auto step = [&](std::size_t i, const VectorXvar& u) -> VectorXvar
+    {
+        const double t = i * dt;
+        VectorXvar v(3); // explicit Euler step of a forced pendulum with stiffness parameter u[2]
+        v[0] = u[0] + dt * u[1];
+        v[1] = u[1] - dt * (u[2] * sin(u[0]) - 0.1 * std::cos(t));
+        v[2] = u[2];
+        return v;
+    };
+
+    VectorXvar u0(3);
+    u0 << 0.5, -0.2, 2.0;
+
+    VectorXvar u = u0;
+    for(auto i = 0U; i < nsteps; ++i)
+        u = step(i, u);
+
+    var yexpected = u[0] * u[0] + u[1] * u[2];
+    VectorXd gexpected = gradient(yexpected, u0);
+
+    for(auto nsnapshots : { 0, 1, 3, 10, 2000 })
+    {
+        VectorXvar v = checkpoint(step, u0, nsteps, nsnapshots);
+
+        CHECK( val(v[0]) == approx(u[0]) );
+        CHECK( val(v[1]) == approx(u[1]) );
+
+        y = v[0] * v[0] + v[1] * v[2];
+        g = gradient(y, u0);
+
+        CHECK( val(y) == approx(yexpected) );
+        CHECK( g[0] == approx(gexpected[0]) );
+        CHECK( g[1] == approx(gexpected[1]) );
+        CHECK( g[2] == approx(gexpected[2]) );
+    }
+
+    // The checkpointed region is recomputed when its inputs change
+    VectorXvar v = checkpoint(step, u0, nsteps, 3);
+    y = v[0] * v[0] + v[1] * v[2];
+    u0[0].update(0.4);
+    y.update();
+
+    u = u0;
+    for(auto i = 0U; i < nsteps; ++i)
+        u = step(i, u);
+
+    CHECK( val(y) == approx(u[0] * u[0] + u[1] * u[2]) );
+
+    // A variable used by the step function is treated as a constant in the region, but not outside it
+    {
+        var p = 2.0;
+        auto scaling = [&](std::size_t, const VectorXvar& w) -> VectorXvar { return w * p; };
+
+        VectorXvar w0(1);
+        w0 << 1.0;
+
+        VectorXvar pw0(2);
+        pw0 << p, w0[0];
+
+        for(auto nsnapshots : { 0, 1 })
+        {
+            VectorXvar wn = checkpoint(scaling, w0, 4, nsnapshots);
+            var z = wn[0] + p;
+            CHECK( val(z) == approx(18.0) );
+            const VectorXd gz = gradient(z, pw0);
+            CHECK( gz[0] == approx(1.0) );
+            CHECK( gz[1] == approx(16.0) );
+        }
+    }
+
+    // The Jacobian matrix through a checkpointed region recomputes its steps once for all rows, and not for rows that do not depend on it
+    {
+        std::size_t calls = 0;
+        auto counted = [&](std::size_t i, const VectorXvar& w) -> VectorXvar { ++calls; return step(i, w); };
+
+        u = u0;
+        for(auto i = 0U; i < nsteps; ++i)
+            u = step(i, u);
+
+        VectorXvar Yexpected(3);
+        Yexpected << u[0], u[1] * u[2], 3.0 * u0[2];
+        const MatrixXd Jexpected = jacobian(Yexpected, u0);
+
+        for(auto nsnapshots : { 1, 10 })
+        {
+            VectorXvar w = checkpoint(counted, u0, nsteps, nsnapshots);
+
+            calls = 0;
+            var z = w[0] * w[1];
+            gradient(z, u0);
+            const auto ncalls = calls;
+
+            VectorXvar Y(3);
+            Y << w[0], w[1] * w[2], 3.0 * u0[2];
+
+            calls = 0;
+            const MatrixXd Jw = jacobian(Y, u0);
+
+            CHECK( calls == ncalls );
+            for(auto i = 0; i < 3; ++i)
+                for(auto j = 0; j < 3; ++j)
+                    CHECK( Jw(i, j) == approx(Jexpected(i, j)) );
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // TESTING REPLAY OF A RECORDED TAPE FOR NEW VALUES OF THE VARIABLES
+    //--------------------------------------------------------------------------
+    auto f = [](const VectorXvar& x) -> var
+    {
+        if(x[0] > 0.0) // branch fixed at recording (checked in each replay)
+            return x.cwiseProduct(x).sum() + max(x[1], x[2]); // max is re-evaluated in each replay
+        return x.sum();
+    };
+
+    x << 1, 2, 3, 4, 5;
+    auto tape = record(f, x);
+
+    VectorXd xnew(5);
+    xnew << 2, 5, 3, 1, 1;
+
+    CHECK( tape.forward(xnew) == approx(xnew.squaredNorm() + 5.0) );
+    CHECK( tape.valid() );
+
+    g = tape.gradient(xnew);
+    for(auto i = 0; i < x.size(); ++i)
+        CHECK( g[i] == approx(2.0 * xnew[i] + (i == 1 ? 1.0 : 0.0)) );
+
+    xnew << 2, 3, 5, 1, 1;
+    g = tape.gradient(xnew);
+    CHECK( tape.valid() );
+    for(auto i = 0; i < x.size(); ++i)
+        CHECK( g[i] == approx(2.0 * xnew[i] + (i == 2 ? 1.0 : 0.0)) );
+
+    y = x.sum(); // record other tapes with the same nodes in between replays
+    gradient(y, x);
+
+    xnew << 1, 1, 1, 1, 1;
+    CHECK( tape.forward(xnew) == approx(6.0) );
+    g = tape.gradient(xnew);
+    CHECK( g[0] == approx(2.0) );
+    CHECK( g[4] == approx(2.0) );
+
+    xnew << -1, 1, 1, 1, 1;
+    tape.forward(xnew);
+    CHECK( !tape.valid() ); // the branch taken in f is no longer the recorded one
+
+    {
+        // Branches decided by comparisons of expression trees that are not part of the result
+        auto fc = [](const VectorXvar& z) -> var
+        {
+            var s = 0.0;
+            for(auto i = 0; i < 3; ++i)
+                if(z[0] * z[1] > double(i)) // z[0] * z[1] is evaluated in each replay together with the tape
+                    s += z[2] * z[2];
+            return s;
+        };
+
+        VectorXvar z(3);
+        z << 1.0, 2.0, 3.0;
+        auto tapec = record(fc, z);
+        CHECK( tapec.comparisons.size() == 3 );
+        CHECK( tapec.branches.empty() );
+        CHECK( tapec.extras.size() == 8 ); // z[0], z[1], the three constants and the three nodes z[0] * z[1]
+
+        VectorXd znew(3);
+        znew << 1.5, 1.0, 2.0;
+        CHECK( tapec.forward(znew) == approx(8.0) );
+        CHECK( tapec.valid() );
+        znew << 0.5, 1.0, 2.0;
+        tapec.forward(znew);
+        CHECK( !tapec.valid() );
+
+        VectorXvar zb(3);
+        zb << 1.0, 2.0, 3.0; // the replays of tapec have changed the values of z
+        auto batchc = record_batch<4>(fc, zb);
+        MatrixXd Z(3, 4);
+        Z << 1.0, 0.5, 1.5, 1.0,
+             2.0, 1.0, 1.0, 1.0,
+             1.0, 2.0, 3.0, 1.0;
+        const auto yc = batchc.forward(Z);
+        CHECK( yc[0] == approx(2.0) );
+        CHECK( yc[2] == approx(18.0) );
+        CHECK( batchc.consistent[0] );
+        CHECK( !batchc.consistent[1] ); // 0.5 <= 1
+        CHECK( batchc.consistent[2] );
+        CHECK( !batchc.consistent[3] ); // 1 <= 1
+    }
+
+    {
+        autodiff::Preaccumulation preaccumulation; // preaccumulated statements cannot be replayed
+        auto fp = [](const VectorXvar& x) -> var { var s = x[0] * x[1]; return s + x[2]; };
+        CHECK_THROWS_AS( record(fp, x), std::logic_error );
+        CHECK_THROWS_AS( record_batch<4>(fp, x), std::logic_error );
+
+        VectorXvar z(1);
+        z << 0.0;
+        var q = z[0] * z[0]; // the second-order derivatives of preaccumulated statements are not supported, even if their derivatives are zero
+        CHECK_THROWS_AS( hessian(q, z), std::logic_error );
+    }
+
+    //--------------------------------------------------------------------------
+    // TESTING REDUCTIONS INTO SINGLE SUM AND DOT EXPRESSION NODES
+    //--------------------------------------------------------------------------
+    x << 1, 2, 3, 4, 5;
+    VectorXvar xs = x.reverse();
+
+    y = x.sum();
+    CHECK( y.expr->operand(0)->arity() == 5 ); // a single n-ary node below the dependent variable node
+    CHECK( val(y) == approx(15.0) );
+
+    y = x.dot(xs) + x.squaredNorm();
+    CHECK( val(y) == approx(1*5 + 2*4 + 3*3 + 4*2 + 5*1 + 55.0) );
+
+    g = gradient(y, x);
+    for(auto i = 0; i < 5; ++i)
+        CHECK( g[i] == approx(2.0 * val(xs[i]) + 2.0 * val(x[i])) );
+
+    H = hessian(y, x);
+    Hs = sparse_hessian(y, x);
+    w << 1, -1, 2, 0, 3;
+    Hv = hessian_vector_product(y, x, w);
+    for(auto i = 0; i < 5; ++i)
+    {
+        for(auto j = 0; j < 5; ++j)
+        {
+            const auto Hij = (i == j ? 2.0 : 0.0) + (i + j == 4 ? 2.0 : 0.0);
+            CHECK( H(i, j) == approx(Hij) );
+            CHECK( Hs.coeff(i, j) == approx(Hij) );
+        }
+        CHECK( Hv[i] == approx(2.0 * w[i] + 2.0 * w[4 - i]) );
+    }
+
+    y = x.norm(); // sqrt(squaredNorm())
+    g = gradient(y, x);
+    for(auto i = 0; i < 5; ++i)
+        CHECK( g[i] == approx(val(x[i]) / std::sqrt(55.0)) );
+
+    y = 0.0;
+    for(auto i = 0; i < 5; ++i)
+        y += x[i] * x[i]; // terms appended to a single sum expression node
+    CHECK( y.expr->operand(0)->arity() == 6 );
+    CHECK( val(y) == approx(55.0) );
+
+    var ycopy = y;
+    y += x[0]; // the sum expression node is shared with ycopy and is not extended in place
+    y += y;
+    CHECK( val(ycopy) == approx(55.0) );
+    CHECK( val(y) == approx(112.0) );
+
+    g = gradient(y, x);
+    for(auto i = 0; i < 5; ++i)
+        CHECK( g[i] == approx(4.0 * val(x[i]) + (i == 0 ? 2.0 : 0.0)) );
+
+    x[0].update(2.0);
+    y.update();
+    CHECK( val(y) == approx(2.0 * (58.0 + 2.0)) );
+
+    //--------------------------------------------------------------------------
+    // TESTING GRADIENTS ACCUMULATED INTO CALLER-PROVIDED VECTORS
+    //--------------------------------------------------------------------------
+    x << 1, 2, 3, 4, 5;
+    y = x.squaredNorm();
+
+    VectorXd gbuf = VectorXd::Ones(7);
+    gradient(y, x, gbuf.segment(1, 5));
+    CHECK( gbuf[0] == 1.0 );
+    CHECK( gbuf[6] == 1.0 );
+    for(auto i = 0; i < 5; ++i)
+        CHECK( gbuf[i + 1] == approx(1.0 + 2.0 * val(x[i])) );
+
+    autodiff::GradientContext<double> context(x);
+    for(auto k = 1; k <= 3; ++k)
+    {
+        y = k * x.sum();
+        gbuf.setZero();
+        gradient(y, context, gbuf.head(5));
+        for(auto i = 0; i < 5; ++i)
+            CHECK( gbuf[i] == approx(double(k)) );
+    }
+
+    //--------------------------------------------------------------------------
+    // TESTING TAPES REPLAYED FOR SEVERAL POINTS AT A TIME
+    //--------------------------------------------------------------------------
+    {
+        auto fb = [](const VectorXvar& z) -> var
+        {
+            var s = z[0] * z[1] + sin(z[0]) / z[1] - exp(z[2]) * sqrt(z[1]);
+            s += condition(z[0] > z[1], z[0] * z[0], 3.0 * z[1]); // selected per lane with a mask
+            s += pow(z[2], 3.0) + tanh(z[0]) - log(z[1]); // pow is evaluated one lane at a time
+            if(z[2] > 0.0)
+                s += z[2];
+            return s;
+        };
+
+        VectorXvar z(3);
+        z << 1.0, 2.0, 0.5;
+
+        auto batch = record_batch<4>(fb, z);
+        auto single = record(fb, z);
+
+        MatrixXd X(3, 4);
+        X << 1.0, 3.0, 0.2, 2.5,
+             2.0, 1.0, 0.7, 1.5,
+             0.5, 0.3, 1.1, -0.4;
+
+        MatrixXd G;
+        const auto yb = batch.gradient(X, G);
+        CHECK( G.rows() == 3 );
+        CHECK( G.cols() == 4 );
+        CHECK( !batch.valid() ); // the last point takes another branch in fb
+        CHECK( !batch.consistent[3] );
+
+        for(auto l = 0; l < 3; ++l)
+        {
+            CHECK( batch.consistent[l] );
+            const VectorXd gl = single.gradient(X.col(l));
+            CHECK( yb[l] == approx(single.forward(X.col(l))) );
+            for(auto k = 0; k < 3; ++k)
+                CHECK( G(k, l) == approx(gl[k]) );
+        }
+    }
+
+    {
+        // Nodes evaluated one lane at a time whose partial derivatives depend on state computed in their evaluation
+        auto fl = [](const VectorXvar& z) -> var { return autodiff::lazy(z[0]) * autodiff::lazy(z[1]) + sin(autodiff::lazy(z[0])); };
+        auto fd = [](const VectorXvar& z) -> var
+        {
+            MatrixXvar M(2, 2);
+            M << z[0], z[1],
+                 1.0, z[0];
+            return determinant(M);
+        };
+
+        VectorXvar z(2);
+        z << 1.0, 5.0;
+
+        MatrixXd X(2, 4);
+        X << 1.0, 2.0, 3.0, 4.0,
+             5.0, 6.0, 7.0, 8.0;
+
+        auto batchl = record_batch<4>(fl, z);
+        auto batchd = record_batch<4>(fd, z);
+
+        MatrixXd Gl, Gd;
+        const auto yl = batchl.gradient(X, Gl);
+        const auto yd = batchd.gradient(X, Gd);
+        for(auto l = 0; l < 4; ++l)
+        {
+            const double a = X(0, l), b = X(1, l);
+            CHECK( yl[l] == approx(a * b + std::sin(a)) );
+            CHECK( Gl(0, l) == approx(b + std::cos(a)) );
+            CHECK( Gl(1, l) == approx(a) );
+            CHECK( yd[l] == approx(a * a - b) );
+            CHECK( Gd(0, l) == approx(2.0 * a) );
+            CHECK( Gd(1, l) == approx(-1.0) );
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // TESTING BLACK-BOX FUNCTIONS WITH USER-SUPPLIED DERIVATIVES
+    //--------------------------------------------------------------------------
+    {
+        // The square root of x[0] by Newton iterations and the product x[0] * x[1], computed with doubles
+        auto forward = [](const double* u, double* v)
+        {
+            double r = u[0];
+            for(auto k = 0; k < 50; ++k)
+                r = 0.5 * (r + u[0] / r);
+            v[0] = r;
+            v[1] = u[0] * u[1];
+        };
+
+        auto pullback = [](const double* u, const double* v, const double* vbar, double* ubar)
+        {
+            ubar[0] += vbar[0] * 0.5 / v[0] + vbar[1] * u[1];
+            ubar[1] += vbar[1] * u[0];
+        };
+
+        VectorXvar u(2);
+        u << 4.0, 3.0;
+
+        VectorXvar v = external(forward, pullback, u, 2);
+        CHECK( v.size() == 2 );
+        CHECK( val(v[0]) == approx(2.0) );
+        CHECK( val(v[1]) == approx(12.0) );
+
+        var f = v[0] * v[1] + sin(u[1]);
+        VectorXd gu = gradient(f, u);
+        CHECK( gu[0] == approx(0.25 * 12.0 + 2.0 * 3.0) );
+        CHECK( gu[1] == approx(2.0 * 4.0 + std::cos(3.0)) );
+
+        u[0].update(9.0); // the black-box function is evaluated again when its outputs are updated
+        f.update();
+        CHECK( val(f) == approx(3.0 * 27.0 + std::sin(3.0)) );
+
+        std::vector<var> w = { u[0], u[1] };
+        auto z = external(forward, pullback, w, 2);
+        CHECK( val(z[0]) == approx(3.0) );
+        CHECK( gradient(z[1], u)[1] == approx(9.0) );
+    }
+    //--------------------------------------------------------------------------
+    // TESTING DENSE LINEAR ALGEBRA NODES (SOLVE, INVERSE, DETERMINANT, CHOLESKY)
+    //--------------------------------------------------------------------------
+    {
+        MatrixXd A0(3, 3);
+        A0 << 4.0, 1.5, 0.5,
+              1.0, 3.0, 0.2,
+              0.5, 0.2, 2.0;
+
+        const VectorXd b0 = VectorXd::LinSpaced(3, 1.0, 3.0);
+        const VectorXd c = VectorXd::LinSpaced(3, -1.0, 2.0);
+
+        VectorXvar a = Eigen::Map<const VectorXd>(A0.data(), 9).cast<var>();
+        VectorXvar b = b0.cast<var>();
+        const Eigen::Map<const MatrixXvar> A(a.data(), 3, 3);
+
+        const MatrixXd Ainv0 = A0.inverse();
+        const VectorXd x0 = A0.partialPivLu().solve(b0);
+
+        // The solution of A x = b and the derivatives of c^T x w.r.t. A and b
+        VectorXvar x = solve(A, b);
+        CHECK( x.size() == 3 );
+        for(auto i = 0; i < 3; ++i)
+            CHECK( val(x[i]) == approx(x0[i]) );
+
+        var f = c.cast<var>().dot(x);
+        const VectorXd bbar = A0.transpose().partialPivLu().solve(c);
+        const MatrixXd Abar = -bbar * x0.transpose();
+        const VectorXd ga = gradient(f, a);
+        const VectorXd gb = gradient(f, b);
+        for(auto i = 0; i < 9; ++i)
+            CHECK( ga[i] == approx(Abar.data()[i]) );
+        for(auto i = 0; i < 3; ++i)
+            CHECK( gb[i] == approx(bbar[i]) );
+
+        // The solution of A X = B with several right-hand sides
+        MatrixXvar B(3, 2);
+        B << b[0], 2.0 * b[0],
+             b[1], 2.0 * b[1],
+             b[2], 2.0 * b[2];
+        MatrixXvar X = solve(A, B);
+        CHECK( X.cols() == 2 );
+        for(auto i = 0; i < 3; ++i)
+            CHECK( val(X(i, 1)) == approx(2.0 * x0[i]) );
+        CHECK( gradient(var(X(1, 0) + X(1, 1)), b)[2] == approx(3.0 * Ainv0(1, 2)) );
+
+        // The inverse of A and the derivatives of its entries w.r.t. A
+        MatrixXvar Y = inverse(A);
+        for(auto i = 0; i < 9; ++i)
+            CHECK( val(Y.data()[i]) == approx(Ainv0.data()[i]) );
+        const VectorXd gy = gradient(Y(0, 2), a);
+        for(auto j = 0; j < 3; ++j)
+            for(auto i = 0; i < 3; ++i)
+                CHECK( gy[j * 3 + i] == approx(-Ainv0(0, i) * Ainv0(j, 2)) );
+
+        // The determinant and log-determinant of A, with derivatives det(A) A^-T and A^-T
+        const double det0 = A0.determinant();
+        var d = determinant(A);
+        var l = logdet(A);
+        CHECK( val(d) == approx(det0) );
+        CHECK( val(l) == approx(std::log(std::abs(det0))) );
+        const VectorXd gd = gradient(d, a);
+        const VectorXd gl = gradient(l, a);
+        for(auto j = 0; j < 3; ++j)
+        {
+            for(auto i = 0; i < 3; ++i)
+            {
+                CHECK( gd[j * 3 + i] == approx(det0 * Ainv0(j, i)) );
+                CHECK( gl[j * 3 + i] == approx(Ainv0(j, i)) );
+            }
+        }
+
+        a[4].update(5.0); // the factorizations are computed again when the nodes are updated
+        A0(1, 1) = 5.0;
+        d.update();
+        l.update();
+        CHECK( val(d) == approx(A0.determinant()) );
+        CHECK( val(l) == approx(std::log(std::abs(A0.determinant()))) );
+        CHECK( gradient(l, a)[0] == approx(A0.inverse()(0, 0)) );
+
+        // The Cholesky factor of a symmetric positive definite matrix, whose upper triangular part is not read
+        MatrixXd S0(3, 3);
+        S0 << 4.0, 9.0, 9.0,
+              1.0, 3.0, 9.0,
+              0.5, 0.2, 2.0;
+
+        VectorXvar s = Eigen::Map<const VectorXd>(S0.data(), 9).cast<var>();
+        const Eigen::Map<const MatrixXvar> S(s.data(), 3, 3);
+
+        MatrixXvar L = cholesky(S);
+        const MatrixXd L0 = S0.llt().matrixL();
+        for(auto i = 0; i < 9; ++i)
+            CHECK( val(L.data()[i]) == approx(L0.data()[i]) );
+
+        // Compare the derivatives of a weighted sum of the entries of L with central finite differences
+        MatrixXd W(3, 3);
+        W << 1.0, 0.0, 0.0,
+            -2.0, 0.5, 0.0,
+             3.0, 1.5, -1.0;
+
+        var g = 0.0;
+        for(auto i = 0; i < 9; ++i)
+            g += W.data()[i] * L.data()[i];
+
+        const VectorXd gs = gradient(g, s);
+        const double h = 1e-6;
+        for(auto j = 0; j < 3; ++j)
+        {
+            for(auto i = 0; i < 3; ++i)
+            {
+                MatrixXd Sp = S0, Sm = S0;
+                Sp(i, j) += h;
+                Sm(i, j) -= h;
+                const MatrixXd Lp = Sp.llt().matrixL();
+                const MatrixXd Lm = Sm.llt().matrixL();
+                const double fd = (W.cwiseProduct(Lp).sum() - W.cwiseProduct(Lm).sum()) / (2.0 * h);
+                CHECK( gs[j * 3 + i] == approx(fd).epsilon(1e-6) );
+            }
+        }
+    }
 }
@@ -0,0 +1,166 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright © 2018–2024 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Catch includes
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+// C++ includes
+#include <stdexcept>
+
+// autodiff includes
+#include <autodiff/reverse/var.hpp>
+#include <autodiff/reverse/var/eigen.hpp>
+#include <autodiff/reverse/var/matrix.hpp>
+
+using autodiff::derivatives;
+using autodiff::gradient;
+using autodiff::matvar;
+using autodiff::MatrixXvar;
+using autodiff::val;
+using autodiff::var;
+using autodiff::VectorXvar;
+using autodiff::wrt;
+
+using Eigen::MatrixXd;
+
+#define CHECK_MATRIX_APPROX(a, b) CHECK(((a) - (b)).norm() == Approx(0.0).margin(1e-10 * (1.0 + (b).norm())))
+
+TEST_CASE("testing autodiff::matvar", "[reverse][var][matrix]")
+{
+    const MatrixXd Aval = MatrixXd::Random(4, 3);
+    const MatrixXd Bval = MatrixXd::Random(3, 5);
+    const MatrixXd Cval = MatrixXd::Random(4, 5);
+
+    matvar A = Aval;
+    matvar B = Bval;
+    matvar C = Cval;
+
+    //=====================================================================================================================
+    //
+    // TESTING SHAPES AND VALUES OF MATRIX OPERATIONS
+    //
+    //=====================================================================================================================
+
+    CHECK( (A * B).rows() == 4 );
+    CHECK( (A * B).cols() == 5 );
+    CHECK( A.transpose().rows() == 3 );
+    CHECK( (A * B).sum().size() == 1 );
+
+    CHECK_MATRIX_APPROX( val(A * B), Aval * Bval );
+    CHECK_MATRIX_APPROX( val(A * B - C), Aval * Bval - Cval );
+    CHECK_MATRIX_APPROX( val(A.transpose() * C), Aval.transpose() * Cval );
+    CHECK_MATRIX_APPROX( val(2.0 * C + C / 4.0), 2.25 * Cval );
+    CHECK( val(C / 3.0) == Cval / 3.0 ); // divided by the constant, not multiplied by its rounded reciprocal
+    CHECK_MATRIX_APPROX( gradient((C / 3.0).sum(), C), MatrixXd::Constant(4, 5, 1.0 / 3.0) );
+    CHECK_THROWS_AS( derivatives(C, wrt(C)), std::logic_error ); // C is not a 1x1 matrix variable
+    CHECK_MATRIX_APPROX( val(exp(C).cwiseProduct(sin(C))), Cval.array().exp().cwiseProduct(Cval.array().sin()).matrix() );
+    CHECK( val((A * B).dot(C))(0, 0) == Approx((Aval * Bval).cwiseProduct(Cval).sum()) );
+
+    //=====================================================================================================================
+    //
+    // TESTING GRADIENTS OF MATRIX OPERATIONS AGAINST ANALYTIC ONES
+    //
+    //=====================================================================================================================
+
+    // d/dA sum(A * B) = 1 * B^T and d/dB sum(A * B) = A^T * 1
+    matvar y = (A * B).sum();
+
+    auto [dydA, dydB, dydC] = derivatives(y, wrt(A, B, C));
+
+    CHECK_MATRIX_APPROX( dydA, MatrixXd::Ones(4, 5) * Bval.transpose() );
+    CHECK_MATRIX_APPROX( dydB, Aval.transpose() * MatrixXd::Ones(4, 5) );
+    CHECK_MATRIX_APPROX( dydC, MatrixXd::Zero(4, 5) );
+
+    // d/dA ||A * B - C||^2 = 2 (A * B - C) B^T
+    y = (A * B - C).squaredNorm();
+
+    CHECK_MATRIX_APPROX( gradient(y, A), 2.0 * (Aval * Bval - Cval) * Bval.transpose() );
+    CHECK_MATRIX_APPROX( gradient(y, C), -2.0 * (Aval * Bval - Cval) );
+
+    //=====================================================================================================================
+    //
+    // TESTING GRADIENTS OF MATRIX OPERATIONS AGAINST THOSE OF MatrixXvar
+    //
+    //=====================================================================================================================
+
+    VectorXvar a = Aval.reshaped().cast<var>();
+    VectorXvar b = Bval.reshaped().cast<var>();
+    VectorXvar c = Cval.reshaped().cast<var>();
+
+    MatrixXvar As = a.reshaped(4, 3);
+    MatrixXvar Bs = b.reshaped(3, 5);
+    MatrixXvar Cs = c.reshaped(4, 5);
+
+    const auto check = [&](const matvar& y, const var& ys)
+    {
+        CHECK( val(y)(0, 0) == Approx(val(ys)) );
+
+        auto [gA, gB, gC] = derivatives(y, wrt(A, B, C));
+
+        MatrixXd gAs = gradient(ys, a).reshaped(4, 3);
+        MatrixXd gBs = gradient(ys, b).reshaped(3, 5);
+        MatrixXd gCs = gradient(ys, c).reshaped(4, 5);
+
+        CHECK_MATRIX_APPROX( gA, gAs );
+        CHECK_MATRIX_APPROX( gB, gBs );
+        CHECK_MATRIX_APPROX( gC, gCs );
+    };
+
+    const auto tanh_ = [](const MatrixXvar& X) -> MatrixXvar { return X.unaryExpr([](const var& x) -> var { return tanh(x); }); };
+    const auto exp_ = [](const MatrixXvar& X) -> MatrixXvar { return X.unaryExpr([](const var& x) -> var { return exp(x); }); };
+    const auto cos_ = [](const MatrixXvar& X) -> MatrixXvar { return X.unaryExpr([](const var& x) -> var { return cos(x); }); };
+
+    check( tanh(A * B).sum(), tanh_(As * Bs).sum() );
+    check( (exp(A * B) - C).squaredNorm(), (exp_(As * Bs) - Cs).squaredNorm() );
+    check( (A * B).cwiseQuotient(exp(C)).dot(cos(C)), (As * Bs).cwiseQuotient(exp_(Cs)).cwiseProduct(cos_(Cs)).sum() );
+    check( ((A.transpose() * C).sum() * (A * B)).sum(), ((As.transpose() * Cs).sum() * (As * Bs)).sum() );
+    check( (log(square(C) + MatrixXd::Ones(4, 5)) - sqrt(square(-A * B))).sum(), ((Cs.cwiseProduct(Cs).array() + 1.0).log() - (As * Bs).cwiseAbs().array()).sum() );
+
+    matvar Z = A * B;
+    Z += C;
+    Z *= 3.0;
+    Z -= A * B;
+    check( Z.squaredNorm(), (3.0 * (As * Bs + Cs) - As * Bs).squaredNorm() );
+
+    //=====================================================================================================================
+    //
+    // TESTING UPDATE OF MATRIX VARIABLES AFTER CHANGES IN THEIR DEPENDENT MATRIX VARIABLES
+    //
+    //=====================================================================================================================
+
+    y = (A * B - C).squaredNorm();
+
+    const MatrixXd Anew = MatrixXd::Random(4, 3);
+    A.update(Anew);
+    y.update();
+
+    CHECK( val(y)(0, 0) == Approx((Anew * Bval - Cval).squaredNorm()) );
+    CHECK_MATRIX_APPROX( gradient(y, A), 2.0 * (Anew * Bval - Cval) * Bval.transpose() );
+}
@@ -529,6 +529,54 @@ TEST_CASE("testing autodiff::var", "[reverse][var]")
     REQUIRE(grad(conditional, x) == approx(2 * val(x)));
     REQUIRE(grad(conditional, y) == approx(0.0));
 
+    // Comparisons, min, max and sgn as dedicated expression nodes
+    x = 1.0;
+    y = 2.0;
+    {
+        using autodiff::reverse::detail::MaxExpr;
+        using autodiff::reverse::detail::MinExpr;
+        using autodiff::reverse::detail::SelectExpr;
+        using autodiff::reverse::detail::SgnExpr;
+
+        var friction = condition(x * y < 1.5, 2.0 * x, x * y); // a piecewise function with a single select expression node
+        REQUIRE( dynamic_cast<SelectExpr<double>*>(friction.expr->operand(0)) );
+        REQUIRE( val(friction) == approx(2.0) );
+        REQUIRE( grad(friction, x) == approx(val(y)) );
+        REQUIRE( grad(friction, y) == approx(val(x)) );
+
+        x.update(0.5);
+        friction.update(); // the comparison is evaluated from the updated value of x * y
+        REQUIRE( val(friction) == approx(1.0) );
+        REQUIRE( grad(friction, x) == approx(2.0) );
+        REQUIRE( grad(friction, y) == approx(0.0) );
+
+        var flipped = condition(!(x < y), x, y);
+        REQUIRE( val(flipped) == approx(val(y)) );
+
+        var lo = min(x, y);
+        var hi = max(x, 3.0 * x);
+        var s = sgn(x - y);
+        REQUIRE( dynamic_cast<MinExpr<double>*>(lo.expr->operand(0)) );
+        REQUIRE( dynamic_cast<MaxExpr<double>*>(hi.expr->operand(0)) );
+        REQUIRE( dynamic_cast<SgnExpr<double>*>(s.expr->operand(0)) );
+        REQUIRE( val(lo) == approx(0.5) );
+        REQUIRE( val(hi) == approx(1.5) );
+        REQUIRE( val(s) == approx(-1.0) );
+        REQUIRE( grad(lo, x) == approx(1.0) );
+        REQUIRE( grad(hi, x) == approx(3.0) );
+        REQUIRE( grad(s, x) == approx(0.0) );
+
+        x.update(4.0);
+        lo.update();
+        s.update();
+        REQUIRE( val(lo) == approx(2.0) );
+        REQUIRE( grad(lo, x) == approx(0.0) );
+        REQUIRE( grad(lo, y) == approx(1.0) );
+        REQUIRE( val(s) == approx(1.0) );
+
+        REQUIRE( val(gradx(gradx(max(x * x, y), x), x)) == approx(2.0) );
+    }
+
     //--------------------------------------------------------------------------
     // TEST OTHER FUNCTIONS
     //--------------------------------------------------------------------------
@@ -581,4 +629,314 @@ TEST_CASE("testing autodiff::var", "[reverse][var]")
     //--------------------------------------------------------------------------
     REQUIRE( val(gradx(gradx(gradx(log(x), x), x), x)) == approx(val(2.0/(x * x * x))) );
     REQUIRE( val(gradx(gradx(gradx(exp(x), x), x), x)) == approx(val(exp(x))) );
+
+    //--------------------------------------------------------------------------
+    // TEST DERIVATIVES OF EXPRESSION TREES WITH HEAVILY SHARED NODES
+    //--------------------------------------------------------------------------
+    x = 1.5;
+    y = x;
+    for(auto i = 0; i < 100; ++i)
+        y = (y + y) * 0.5; // each node is reached through 2^i paths from y
+
+    REQUIRE( val(y) == approx(x) );
+    REQUIRE( grad(y, x) == approx(1.0) );
+
+    y = x;
+    for(auto i = 0; i < 100; ++i)
+        y = y * y / y;
+
+    REQUIRE( val(y) == approx(x) );
+    REQUIRE( grad(y, x) == approx(1.0) );
+
+    //--------------------------------------------------------------------------
+    // TEST DERIVATIVES OF EXPRESSION TREES ALLOCATED IN A MEMORY ARENA
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    {
+        autodiff::ExprArena arena;
+        var u = 2.0;
+        var w = u * sin(x) + exp(u * x);
+
+        REQUIRE( val(w) == approx(2.0 * std::sin(0.5) + std::exp(1.0)) );
+        REQUIRE( grad(w, x) == approx(2.0 * std::cos(0.5) + 2.0 * std::exp(1.0)) );
+        REQUIRE( grad(w, u) == approx(std::sin(0.5) + 0.5 * std::exp(1.0)) );
+
+        y = w * w; // y outlives the arena and keeps its memory alive
+    }
+    REQUIRE( val(y) == approx(std::pow(2.0 * std::sin(0.5) + std::exp(1.0), 2)) );
+    REQUIRE( grad(y, x) == approx(2.0 * val(y) / (2.0 * std::sin(0.5) + std::exp(1.0)) * (2.0 * std::cos(0.5) + 2.0 * std::exp(1.0))) );
+
+    //--------------------------------------------------------------------------
+    // TEST DERIVATIVES OF VERY DEEP EXPRESSION TREES (e.g. long time integrations)
+    //--------------------------------------------------------------------------
+    x = 1.0;
+    y = x;
+    for(auto i = 0; i < 200000; ++i)
+        y = y + 1.0e-5 * sin(y); // explicit Euler steps of dy/dt = sin(y)
+
+    double dydx = 1.0;
+    double yval = 1.0;
+    for(auto i = 0; i < 200000; ++i)
+    {
+        dydx *= 1.0 + 1.0e-5 * std::cos(yval);
+        yval += 1.0e-5 * std::sin(yval);
+    }
+
+    REQUIRE( val(y) == approx(yval) );
+    REQUIRE( grad(y, x) == approx(dydx) );
+
+    x.update(1.5);
+    y.update();
+
+    REQUIRE( val(y) != approx(yval) );
+
+    y = x; // the deep expression tree above is released here without exhausting the stack
+    REQUIRE( val(y) == 1.5 );
+
+    //--------------------------------------------------------------------------
+    // TEST CREATION OF IDENTICAL EXPRESSION NODES ONLY ONCE (HASH-CONSING)
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    {
+        autodiff::ExprCache cache;
+
+        var s1 = sin(x) * y;
+        var s2 = y * sin(x) + 3.0;
+        var s3 = 3.0 + sin(y);
+
+        REQUIRE( s1.expr->operand(0) == s2.expr->operand(0)->operand(0) ); // y * sin(x) is the node sin(x) * y
+        REQUIRE( (x + 3.0).get() == (3.0 + x).get() ); // a single node x + 3.0
+        REQUIRE( (x + 3.0).get() != (x + 4.0).get() ); // the constants stored in the nodes differ
+
+        var s4 = cos(sin(x));
+        var s5 = cos(sin(y));
+
+        REQUIRE( s4.expr->operand(0)->operand(0) == s1.expr->operand(0)->operand(0) ); // a single node sin(x)
+        REQUIRE( s5.expr->operand(0)->operand(0) == s3.expr->operand(0)->operand(0) ); // a single node sin(y)
+        REQUIRE( s4.expr->operand(0) != s5.expr->operand(0) );
+
+        r = s1 * s2 + s3;
+
+        REQUIRE( val(r) == approx(2.0 * std::sin(0.5) * (2.0 * std::sin(0.5) + 3.0) + 3.0 + std::sin(2.0)) );
+        REQUIRE( grad(r, x) == approx(2.0 * std::cos(0.5) * (2.0 * std::sin(0.5) + 3.0) + 2.0 * std::sin(0.5) * 2.0 * std::cos(0.5)) );
+        REQUIRE( grad(r, y) == approx(std::sin(0.5) * (4.0 * std::sin(0.5) + 3.0) + std::cos(2.0)) );
+
+        REQUIRE( grad(gradx(r, x), x) == approx(8.0 * std::cos(0.5) * std::cos(0.5) - std::sin(0.5) * (8.0 * std::sin(0.5) + 6.0)) );
+
+        x.update(1.0); // an existing node returned by the cache has the value for its updated child nodes
+        REQUIRE( val(sin(x)) == approx(std::sin(1.0)) );
+        REQUIRE( val(sin(x) * y) == approx(2.0 * std::sin(1.0)) );
+        x.update(0.5);
+
+        REQUIRE( autodiff::reverse::detail::constant(-0.0).get() != autodiff::reverse::detail::constant(0.0).get() ); // values are compared bit by bit
+        REQUIRE( std::signbit(val(var(autodiff::reverse::detail::constant(-0.0)))) );
+    }
+    x.update(1.0); // nodes created in the cache outlive it and are still updated
+    r.update();
+    REQUIRE( val(r) == approx(2.0 * std::sin(1.0) * (2.0 * std::sin(1.0) + 3.0) + 3.0 + std::sin(2.0)) );
+
+    //--------------------------------------------------------------------------
+    // TEST PRODUCTS AND SUMS WITH CONSTANTS STORED IN THE NODES AND CONSTANT FOLDING
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    r = 2.0 * x + 1.0; // a ShiftExpr node over a ScaleExpr node, without ConstantExpr nodes
+    REQUIRE( r.expr->operand(0)->arity() == 1 );
+    REQUIRE( r.expr->operand(0)->operand(0)->arity() == 1 );
+    REQUIRE( r.expr->operand(0)->operand(0)->operand(0) == x.expr.get() );
+    REQUIRE( val(r) == approx(2.0) );
+    REQUIRE( grad(r, x) == approx(2.0) );
+    REQUIRE( gradx(r, x).expr->operand(0)->isconstant() );
+
+    r = (x - 1.0) * (3.0 - x) / 4.0 + 2.0 / x;
+    REQUIRE( val(r) == approx(-0.5 * 2.5 / 4.0 + 4.0) );
+    REQUIRE( grad(r, x) == approx(((3.0 - 0.5) - (0.5 - 1.0)) / 4.0 - 2.0 / 0.25) );
+    REQUIRE( grad(gradx(r, x), x) == approx(-0.5 + 4.0 / 0.125) );
+
+    auto k = sin(autodiff::reverse::detail::constant(0.5)) * autodiff::reverse::detail::constant(2.0) + 1.0;
+    REQUIRE( k->isconstant() ); // no expression node is created for operations on constants only
+    REQUIRE( k->val == approx(2.0 * std::sin(0.5) + 1.0) );
+
+    r = x * k;
+    REQUIRE( r.expr->operand(0)->operand(0) == x.expr.get() ); // x * k is a ScaleExpr node
+    REQUIRE( grad(r, x) == approx(2.0 * std::sin(0.5) + 1.0) );
+
+    for(auto xval : { 0.1, 0.7, 1.3, 2.9, 5.0, 17.0 })
+    {
+        x = xval;
+        r = x / 3.0; // a QuotientExpr node, whose value is the IEEE quotient (not x * (1.0/3.0))
+        REQUIRE( r.expr->operand(0)->operand(0) == x.expr.get() );
+        REQUIRE( val(r) == xval / 3.0 );
+        REQUIRE( val(x / autodiff::reverse::detail::constant(3.0)) == xval / 3.0 );
+        REQUIRE( grad(r, x) == approx(1.0 / 3.0) );
+        x.update(xval + 1.0);
+        r.update();
+        REQUIRE( val(r) == (xval + 1.0) / 3.0 );
+    }
+
+    //--------------------------------------------------------------------------
+    // TEST REFERENCE COUNTS EMBEDDED IN EXPRESSION NODES
+    //--------------------------------------------------------------------------
+    x = 1.0;
+    REQUIRE( x.expr.use_count() == 1 );
+    {
+        var u = x * x + sin(x);
+        REQUIRE( x.expr.use_count() == 4 ); // x, and three references in the expression tree of u
+        var v = u;
+        REQUIRE( u.expr.use_count() == 2 ); // u, and the dependent variable node of its copy v
+        REQUIRE( grad(v, x) == approx(2.0 + std::cos(1.0)) );
+    }
+    REQUIRE( x.expr.use_count() == 1 );
+    //--------------------------------------------------------------------------
+    // TEST PARTIAL DERIVATIVES COMPUTED FROM THE OPERATION CODES IN THE TAPE
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    r = -tanh(x) * 3.0 + sqrt(y) / exp(x) - log(y) + cos(x) * sin(y) + (x + y + 1.0) + atan(x); // atan(x) is a node without an operation code
+    REQUIRE( grad(r, x) == approx(-3.0 / (std::cosh(0.5) * std::cosh(0.5)) - std::sqrt(2.0) / std::exp(0.5) - std::sin(0.5) * std::sin(2.0) + 1.0 + 1.0 / 1.25) );
+    REQUIRE( grad(r, y) == approx(0.5 / (std::sqrt(2.0) * std::exp(0.5)) - 0.5 + std::cos(0.5) * std::cos(2.0) + 1.0) );
+    //--------------------------------------------------------------------------
+    // TEST PARTIAL DERIVATIVES STORED IN THE TAPE AND REUSED IN SEVERAL SWEEPS
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    r = pow(x, y) + erf(x) * hypot(x, y) + sqrt(y);
+    {
+        autodiff::reverse::detail::Tape<double> tape(r.expr.get());
+        tape.store();
+        for(auto sweep = 0; sweep < 2; ++sweep)
+        {
+            tape.propagate(1.0);
+            REQUIRE( tape.adjoint(x.expr.get()) == approx(grad(r, x)) );
+            REQUIRE( tape.adjoint(y.expr.get()) == approx(grad(r, y)) );
+        }
+        x.update(1.5); // the stored partial derivatives are recomputed when the tape is updated
+        tape.update();
+        tape.propagate(1.0);
+        REQUIRE( tape.adjoint(x.expr.get()) == approx(grad(r, x)) );
+        REQUIRE( tape.adjoint(x.expr.get()) == approx(2.0 * 1.5 + 2.0 / std::sqrt(M_PI) * std::exp(-2.25) * std::hypot(1.5, 2.0) + std::erf(1.5) * 1.5 / std::hypot(1.5, 2.0)) );
+    }
+    //--------------------------------------------------------------------------
+    // TEST STATEMENT-LEVEL PREACCUMULATION OF EXPRESSION TREES
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    {
+        autodiff::Preaccumulation preaccumulation;
+
+        var s = x * y + sin(x) * exp(y) - 3.0; // a single expression node with child expression nodes x and y
+        REQUIRE( s.expr->operand(0)->arity() == 2 );
+        REQUIRE( s.expr->operand(0)->operand(0) == x.expr.get() );
+        REQUIRE( s.expr->operand(0)->operand(1) == y.expr.get() );
+        REQUIRE( val(s) == approx(1.0 + std::sin(0.5) * std::exp(2.0) - 3.0) );
+        REQUIRE( x.expr.use_count() == 2 ); // the intermediate expression nodes of the statement are released
+
+        var t = s * s + x; // the inputs of this statement are s and x
+        REQUIRE( t.expr->operand(0)->operand(0) == s.expr.get() );
+        REQUIRE( grad(t, x) == approx(2.0 * val(s) * (2.0 + std::cos(0.5) * std::exp(2.0)) + 1.0) );
+        REQUIRE( grad(t, y) == approx(2.0 * val(s) * (0.5 + std::sin(0.5) * std::exp(2.0))) );
+
+        var u = s; // copies of variables are not collapsed
+        REQUIRE( u.expr->operand(0) == s.expr.get() );
+
+        REQUIRE_THROWS_AS( gradx(t, x), std::logic_error );
+
+        var z = 0.0;
+        var q = z * z; // an expression node with child expression node z (with zero derivative), not a constant
+        REQUIRE( q.expr->operand(0)->arity() == 1 );
+        REQUIRE( q.expr->operand(0)->operand(0) == z.expr.get() );
+
+        q.update(); // the inputs have not changed
+        REQUIRE( val(q) == 0.0 );
+        z.update(3.0);
+        REQUIRE_THROWS_AS( q.update(), std::logic_error ); // the statement cannot be recomputed for new values of its inputs
+    }
+    r = x * y; // the mode is no longer active
+    REQUIRE( r.expr->operand(0)->arity() == 2 );
+    REQUIRE( r.expr->operand(0)->operand(0) == x.expr.get() );
+    REQUIRE( x.expr.use_count() == 2 );
+    //--------------------------------------------------------------------------
+    // TEST STATEMENTS BUILT FROM COMPILE-TIME EXPRESSIONS
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    {
+        using autodiff::lazy;
+
+        var s = lazy(x) * y + sin(lazy(x)) / 2.0 - exp(-lazy(y)) * log(lazy(y)) + sqrt(y * lazy(x)) - tanh(lazy(x));
+        REQUIRE( s.expr->operand(0)->arity() == 8 ); // a single expression node, with child expression nodes x, y, x, y, y, y, x, x
+        REQUIRE( s.expr->operand(0)->operand(0) == x.expr.get() );
+        REQUIRE( s.expr->operand(0)->operand(1) == y.expr.get() );
+        REQUIRE( x.expr.use_count() == 5 ); // x, and the four references in the expression node of s
+
+        const auto sval = 1.0 + std::sin(0.5) / 2.0 - std::exp(-2.0) * std::log(2.0) + 1.0 - std::tanh(0.5);
+        REQUIRE( val(s) == approx(sval) );
+        REQUIRE( grad(s, x) == approx(2.0 + std::cos(0.5) / 2.0 + 1.0 - 1.0 / (std::cosh(0.5) * std::cosh(0.5))) );
+        REQUIRE( grad(s, y) == approx(0.5 + std::exp(-2.0) * std::log(2.0) - std::exp(-2.0) / 2.0 + 0.25) );
+
+        var t = cos(lazy(s)) * tan(lazy(x)); // statements can be chained
+        REQUIRE( grad(t, x) == approx(-std::sin(sval) * grad(s, x) * std::tan(0.5) + std::cos(sval) / (std::cos(0.5) * std::cos(0.5))) );
+
+        x.update(1.0); // the values of statements are updated with those of their variables
+        s.update();
+        REQUIRE( val(s) == approx(2.0 + std::sin(1.0) / 2.0 - std::exp(-2.0) * std::log(2.0) + std::sqrt(2.0) - std::tanh(1.0)) );
+        REQUIRE( grad(s, x) == approx(2.0 + std::cos(1.0) / 2.0 + 1.0 / std::sqrt(2.0) - 1.0 / (std::cosh(1.0) * std::cosh(1.0))) );
+
+        r = 2.0 * lazy(x) - lazy(x);
+        REQUIRE( grad(r, x) == approx(1.0) );
+
+        REQUIRE_THROWS_AS( gradx(s, x), std::logic_error );
+    }
+    //--------------------------------------------------------------------------
+    // TEST REVERSE SWEEPS RESTRICTED TO EXPRESSION NODES THAT DEPEND ON GIVEN VARIABLES
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    {
+        var z = 3.0;
+        var s = sin(z) * exp(y) + 2.0 * sqrt(z); // does not depend on x
+        r = x * s + x * x;
+
+        auto [dx] = derivatives(r, wrt(x));
+        REQUIRE( dx == approx(val(s) + 1.0) );
+
+        auto [dxx] = derivativesx(r, wrt(x));
+        REQUIRE( val(dxx) == approx(val(s) + 1.0) );
+        REQUIRE( grad(dxx, x) == approx(2.0) );
+
+        autodiff::reverse::detail::Tape<double> tape(r.expr.get());
+        const autodiff::reverse::detail::Expr<double>* wrtnodes[] = { x.expr.get() };
+        tape.activate(wrtnodes, 1);
+        REQUIRE( tape.inactive(s.expr->index) );
+        REQUIRE( tape.inactive(z.expr->index) );
+        REQUIRE_FALSE( tape.inactive(r.expr->index) );
+        tape.propagate(1.0);
+        REQUIRE( tape.adjoint(x.expr.get()) == approx(val(s) + 1.0) );
+        REQUIRE( tape.adjoint(z.expr.get()) == 0.0 ); // the subtree of s is not swept
+    }
+    //--------------------------------------------------------------------------
+    // TEST DERIVATIVES ACCUMULATED INTO CALLER BUFFERS
+    //--------------------------------------------------------------------------
+    x = 0.5;
+    y = 2.0;
+    {
+        double grad[2] = { 1.0, 0.0 };
+        r = x * y + sin(x);
+        derivatives(r, wrt(x, y), grad);
+        REQUIRE( grad[0] == approx(1.0 + val(y) + std::cos(0.5)) );
+        REQUIRE( grad[1] == approx(val(x)) );
+
+        autodiff::GradientContext<double> context(wrt(y, x));
+        REQUIRE( context.size() == 2 );
+
+        for(auto k = 0; k < 3; ++k) // the same context is reused with new expression trees
+        {
+            x.update(0.5 * k); // the variables stay bound to the context while their values change
+            r = x * x * y;
+            double g[2] = {};
+            context.accumulate(r, g);
+            REQUIRE( g[0] == approx(val(x) * val(x)) );
+            REQUIRE( g[1] == approx(2.0 * val(x) * val(y)) );
+        }
+    }
 }